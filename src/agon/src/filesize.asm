@@ -5,7 +5,7 @@
 ; Gets filesize from an open file
 ; requires MOS mos_getfil call
 ; Input: MOS filehandle
-; Output: HL - 24bit filesize
+; Output: E:HL - 32bit filesize
 
 _getfilesize:
   PUSH IX
@@ -18,9 +18,16 @@ _getfilesize:
   LD  A,	19h		; MOS_GETFIL API call
   RST.LIL 08h
 
-  LD  DE, 11    ; offset to lower 3bytes in FSIZE_t, part of the FFOBJD struct that HL points to
+  LD  DE, 11    ; offset to FSIZE_t, part of the FFOBJD struct that HL points to
   ADD HL, DE
-  LD  HL, (HL)  ; load actual FSIZE_t value (lower 3 bytes)
+  LD  DE, (HL)  ; lower 3 bytes of FSIZE_t
+  INC HL
+  INC HL
+  INC HL
+  LD  A, (HL)   ; upper byte of FSIZE_t
+  EX  DE, HL    ; HL - lower 3 bytes
+  LD  DE, 0
+  LD  E, A      ; E - upper byte
 
   LD	SP, IX
   POP	IX
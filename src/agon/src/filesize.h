@@ -1,6 +1,6 @@
 #ifndef FILESIZE_H
 #define FILESIZE_H
 
-extern uint24_t getfilesize(uint8_t fh);
+extern uint32_t getfilesize(uint8_t fh);
 
 #endif
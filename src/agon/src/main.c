@@ -19,11 +19,21 @@
 
 #define MAXDIRLENGTH                   256
 #define MAXNAMELENGTH                  100
+#define MAXDIRDEPTH                    8
 #define YMODEM_RECEIVE                 1
 #define YMODEM_SEND                    2
 #define YMODEM_PACKET_1K_SIZE          1024
 #define YMODEM_PACKET_HEADER           3
 #define YMODEM_PACKET_TRAILER          2
+#define WRITE_BUFFER_SIZE              16384          // received data goes to the SD card in blocks of this size, a typical cluster
+#define SERVER_COMMAND_NAME            ".ymodem"      // batch file with a command for the server, not stored
+#define SERVER_COMMAND_LENGTH          YMODEM_PACKET_1K_SIZE
+#define SERVER_LISTING_NAME            ".ymodem.lst"
+#define SERVER_RESULT_NAME             ".ymodem.res"  // reply to filesystem operations, a result per operation
+#define SERVER_MAXARGS                 32
+#define SERVER_MAXOPS                  64
+#define SERVER_LIST_CRC                0x01           // listing flag: records carry the CRC32 of each file
+#define SERVER_BAD_OPERATION           0xFF
 
 #define MAXDEBUGLIST                  15
 
@@ -67,21 +77,86 @@ bool set_VDP_ymodem(uint8_t direction) {
   return true;
 }
 
+// Last directory make_parent_dirs() created or found, forgotten when the filesystem may have changed
+static char lastdir[MAXDIRLENGTH+MAXNAMELENGTH+1];
+
+// Creates the subdirectories of a received filename, below the receive path
+// Consecutive files in the same directory don't repeat the MOS calls
+void make_parent_dirs(char *filename, unsigned int start) {
+  char *end = strrchr(filename + start, '/');
+
+  if(end == NULL) return;
+  *end = 0;
+  if(strcmp(filename, lastdir) != 0) {
+    for(char *p = filename + start; *p; p++) {
+      if(*p == '/') {
+        *p = 0;
+        mos_mkdir(filename);
+        *p = '/';
+      }
+    }
+    mos_mkdir(filename);
+    strcpy(lastdir, filename);
+  }
+  *end = '/';
+}
+
+// A received name has to stay below the receive path, as ymodem_sanitize_filename() on the PC checks
+bool valid_name(const char *name) {
+  const char *p;
+
+  if(*name == 0) return false;
+  for(p = name; p; p = strchr(p, '/')) {
+    if(*p == '/') p++;
+    if((strncmp(p, "..", 2) == 0) && ((p[2] == '/') || (p[2] == 0))) return false;
+  }
+  return true;
+}
+
 char stringlist[MAXDEBUGLIST][256];
-int namelengthlist[MAXDEBUGLIST];
+uint32_t namelengthlist[MAXDEBUGLIST];
+
+// Received packets are collected into cluster sized writes at cluster aligned offsets,
+// instead of a partial sector write per packet. Packets that fit are received straight
+// into the buffer.
+static uint8_t write_buffer[WRITE_BUFFER_SIZE];
+static unsigned int write_fill;
+
+void write_flush(uint8_t fh) {
+  if(write_fill) mos_fwrite(fh, (char *)write_buffer, write_fill);
+  write_fill = 0;
+}
+
+void write_data(uint8_t fh, const char *data, unsigned int length) {
+  unsigned int n;
+
+  while(length) {
+    n = WRITE_BUFFER_SIZE - write_fill;
+    if(n > length) n = length;
+    if(data != (char *)write_buffer + write_fill) memcpy(write_buffer + write_fill, data, n);
+    write_fill += n;
+    data += n;
+    length -= n;
+    if(write_fill == WRITE_BUFFER_SIZE) write_flush(fh);
+  }
+}
 
-int get_files(const char *path) {
+// Receives a batch to 'path'. With 'command', a file named SERVER_COMMAND_NAME isn't stored,
+// its contents are returned in 'command' instead.
+int get_files(const char *path, char *command) {
   unsigned int filename_length;
-  unsigned int file_length;
+  uint32_t file_length;
   unsigned int packet_length;
   unsigned filenumber;
   uint8_t state;
-  char filename[MAXNAMELENGTH];
+  char filename[MAXNAMELENGTH+1];
   char mosfilename[MAXDIRLENGTH+MAXNAMELENGTH+1];
   char *ptr;
   uint8_t mosfh;
   uint8_t buffer[YMODEM_PACKET_1K_SIZE];
   uint32_t crc32_target, crc32_result;
+  unsigned int command_length = 0;
+  bool incommand = false;
 
   // DEBUG
   for(int i = 0; i < 3; i++ ){
@@ -89,6 +164,7 @@ int get_files(const char *path) {
     namelengthlist[i] = 0;
   }
   // DEBUG END
+  lastdir[0] = 0;
   if(!set_VDP_ymodem(YMODEM_RECEIVE)) return 0;
 
   filenumber = 0;
@@ -105,9 +181,31 @@ int get_files(const char *path) {
         ptr = (char*)buffer;
         filenumber++;
         filename_length = readint();
-        getblock(filename, filename_length);
+        if(filename_length > MAXNAMELENGTH) {
+          while(filename_length--) getbyte();  // drained, the reply follows the whole header
+          filename_length = 0;
+        }
+        else getblock(filename, filename_length);
         filename[filename_length] = 0;
         file_length = readint();
+        ptr = filename;
+        while(*ptr == '/') ptr++;
+        if(!valid_name(ptr)) {  // too long, empty, or outside the receive path
+          putch('S'); // sync
+          putch('X'); // Abort
+          if(command) command[0] = 0;
+          return filenumber - 1;
+        }
+        incommand = command && (strcmp(ptr, SERVER_COMMAND_NAME) == 0);
+        if(incommand) {
+          filenumber--;
+          command_length = 0;
+          ptr = (char*)buffer;
+          crc32_initialize();
+          putch('S'); // sync
+          putch('1');
+          break;
+        }
         // DEBUG
         if(filenumber < MAXDEBUGLIST) {
           strcpy(stringlist[filenumber-1], filename);
@@ -115,17 +213,53 @@ int get_files(const char *path) {
         }
         // DEBUG END
         strcpy(mosfilename, path);
-        strcat(mosfilename, filename);
+        ptr = filename;
+        while(*ptr == '/') ptr++;
+        strcat(mosfilename, ptr);
+        ptr = (char*)buffer;
+        make_parent_dirs(mosfilename, strlen(path));
         mosfh = mos_fopen(mosfilename, FA_WRITE | FA_CREATE_ALWAYS);
+        if(mosfh == 0) {
+          putch('S'); // sync
+          putch('X'); // Abort
+          return filenumber - 1;
+        }
+        write_fill = 0;
+        if(file_length) {
+          // Allocates the cluster chain once, rather than a cluster at a time while writing
+          mos_flseek(mosfh, file_length);
+          mos_flseek(mosfh, 0);
+        }
         crc32_initialize();
         putch('S'); // sync
         putch('1');
         break;
       case 2: // Data packet
         packet_length = readint();
+        if(packet_length > YMODEM_PACKET_1K_SIZE) {
+          while(packet_length--) getbyte();  // drained, the reply follows the whole packet
+          putch('S'); // sync
+          putch('X'); // Abort
+          if(incommand) {
+            command[0] = 0;
+            return filenumber;
+          }
+          write_fill = 0;
+          mos_fclose(mosfh);
+          mos_del(mosfilename);
+          return filenumber - 1;
+        }
+        ptr = (char*)buffer;
+        if(!incommand && (packet_length <= WRITE_BUFFER_SIZE - write_fill)) ptr = (char*)write_buffer + write_fill;
         getblock(ptr, packet_length);
         crc32(ptr, packet_length);
-        mos_fwrite(mosfh, ptr, packet_length);
+        if(incommand) {
+          if(packet_length > SERVER_COMMAND_LENGTH - 1 - command_length) packet_length = SERVER_COMMAND_LENGTH - 1 - command_length;
+          memcpy(command + command_length, ptr, packet_length);
+          command_length += packet_length;
+          command[command_length] = 0;
+        }
+        else write_data(mosfh, ptr, packet_length);
         putch('S'); // sync
         putch('2');
         break;
@@ -135,23 +269,33 @@ int get_files(const char *path) {
         putch('S'); // sync
         if(crc32_target != crc32_result) {
           putch('X'); // Abort
+          if(incommand) {
+            command[0] = 0;
+            return filenumber;
+          }
+          write_fill = 0;
           mos_fclose(mosfh);
-          mos_del(filename);
+          mos_del(mosfilename);
           filenumber--;
           return filenumber;
         }
         putch('V'); // Verified
         break;
       case 4: // End-of-transmission (file)
-        mos_fclose(mosfh);
+        if(!incommand) {
+          write_flush(mosfh);
+          mos_fclose(mosfh);
+        }
         putch('S'); // sync
         putch('4');
         break;
       case 0xff:
       default:
-        if(filenumber) {
+        if(incommand) command[0] = 0;
+        else if(filenumber) {
+          write_fill = 0;
           mos_fclose(mosfh);
-          mos_del(filename);
+          mos_del(mosfilename);
           filenumber--;
         }
         return filenumber;
@@ -159,16 +303,23 @@ int get_files(const char *path) {
   }
 }
 
-bool check_files(int filecount, char *filelist[]) {
+bool check_files(int filecount, char *filelist[], bool recursive) {
   bool allfiles_exist = true;
   bool allnames_ok = true;
 
   for(int i = 0; i < filecount; i++) {
-    uint8_t mosfh = mos_fopen(filelist[i], FA_READ);
     if(strlen(filelist[i]) > MAXNAMELENGTH) {
       printf("File \'%s\' - name too large\r\n", filelist[i]);
       allnames_ok = false;
     }
+    if(mos_isdirectory(filelist[i]) == 0) {
+      if(!recursive) {
+        printf("\'%s\' is a directory, use -R\r\n", filelist[i]);
+        allfiles_exist = false;
+      }
+      continue;
+    }
+    uint8_t mosfh = mos_fopen(filelist[i], FA_READ);
     if(mosfh == 0) {
       printf("File \'%s\' does not exist\r\n", filelist[i]);
       allfiles_exist = false;
@@ -180,51 +331,265 @@ bool check_files(int filecount, char *filelist[]) {
   return allfiles_exist && allnames_ok;
 }
 
-void send_files(int filecount, char *filelist[]) {
+static uint8_t send_buffer[YMODEM_PACKET_1K_SIZE];
+static DIR send_dirs[MAXDIRDEPTH];
+static FILINFO send_fileinfo;
+static char send_path[MAXDIRLENGTH+MAXNAMELENGTH+1];
+static unsigned int send_skipped;
+static unsigned int send_namestart;  // where the name sent for an entry starts in send_path
+
+// Sends a single file under 'name'. 'remaining' tells the VDP more files will follow this one.
+bool send_file(const char *filename, const char *name, unsigned int remaining) {
   unsigned int filename_length;
-  unsigned int filesize;
-  unsigned int remaining;
-  char filename[MAXNAMELENGTH+1];
+  unsigned int write_len;
+  uint32_t filesize;
   uint8_t mosfh;
-  uint8_t buffer[YMODEM_PACKET_1K_SIZE];
 
-  remaining = filecount;
+  crc32_initialize();
+  mosfh = mos_fopen(filename, FA_READ);
+  if(mosfh == 0) {
+    writeint(0);
+    return false;
+  }
+  else writeint(remaining);
+
+  filename_length = strlen(name);
+  writeint(filename_length);
+  putblock((char*)name, filename_length);  // send filename
+  filesize = getfilesize(mosfh);
+  writeint(filesize);
+
+  while(filesize) {
+    write_len = mos_fread(mosfh, (char*)send_buffer, (filesize < YMODEM_PACKET_1K_SIZE) ? filesize : YMODEM_PACKET_1K_SIZE);
+    if(write_len == 0) break;  // read error, or the file was truncated while being sent
+    putblock((char*)send_buffer, write_len);
+    crc32((char*)send_buffer, write_len);
+    filesize -= write_len;
+  }
+  mos_fclose(mosfh);
+  if(filesize) {
+    // The announced size has to be sent in full; the CRC is spoiled so the receiver rejects the file
+    memset(send_buffer, 0, YMODEM_PACKET_1K_SIZE);
+    while(filesize) {
+      write_len = (filesize < YMODEM_PACKET_1K_SIZE) ? filesize : YMODEM_PACKET_1K_SIZE;
+      putblock((char*)send_buffer, write_len);
+      filesize -= write_len;
+    }
+    writeint(~crc32_finalize());
+    return false;
+  }
+  writeint(crc32_finalize());
+  return true;
+}
 
-  if(!set_VDP_ymodem(YMODEM_SEND)) return; 
+// Walks send_path one directory entry at a time, sending each file as it is found.
+// Entries that can't be sent by name or depth are counted in send_skipped, as the
+// screen can't be used while the VDP is in ymodem mode.
+bool send_directory(unsigned int depth, unsigned int remaining) {
+  DIR *dir = &send_dirs[depth];
+  unsigned int pathlength = strlen(send_path);
+  unsigned int namestart = pathlength;
+  bool ok = true;
+
+  if(ffs_dopen(dir, send_path) != 0) {
+    send_skipped++;
+    return true;
+  }
+  if(send_path[pathlength-1] != '/') namestart++;
+
+  while(ok && (ffs_dread(dir, &send_fileinfo) == 0) && send_fileinfo.fname[0]) {
+    if((strcmp(send_fileinfo.fname, ".") == 0) || (strcmp(send_fileinfo.fname, "..") == 0)) continue;
+    if((namestart - send_namestart + strlen(send_fileinfo.fname) > MAXNAMELENGTH) ||
+       (namestart + strlen(send_fileinfo.fname) >= sizeof(send_path))) {
+      send_skipped++;
+      continue;
+    }
+    send_path[pathlength] = '/';
+    strcpy(send_path + namestart, send_fileinfo.fname);
+    if(send_fileinfo.fattrib & AM_DIR) {
+      if(depth + 1 < MAXDIRDEPTH) ok = send_directory(depth + 1, remaining);
+      else send_skipped++;
+    }
+    else ok = send_file(send_path, send_path + send_namestart, remaining);
+    send_path[pathlength] = 0;
+  }
+  ffs_dclose(dir);
+  return ok;
+}
 
-  for(int filenumber = 0; filenumber < filecount; filenumber++) {
-    crc32_initialize();
-    mosfh = mos_fopen(filelist[filenumber], FA_READ);
-    if(mosfh == 0) {
-      writeint(0);
-      printf("Error MOS\r\n");
-      return;
+static void putint(uint8_t *p, uint32_t value) {
+  p[0] = (uint8_t)(value & 0xFF);
+  p[1] = (uint8_t)((value >> 8) & 0xFF);
+  p[2] = (uint8_t)((value >> 16) & 0xFF);
+  p[3] = (uint8_t)((value >> 24) & 0xFF);
+}
+
+// Announces a file that isn't read from disk, its data follows
+void send_header(const char *name, uint32_t filesize, unsigned int remaining) {
+  unsigned int length = strlen(name);
+
+  writeint(remaining);
+  writeint(length);
+  putblock((char*)name, length);
+  writeint(filesize);
+  crc32_initialize();
+}
+
+// Sends a buffer as a file named 'name'
+void send_memory(const char *name, const uint8_t *data, unsigned int length, unsigned int remaining) {
+  send_header(name, length, remaining);
+  if(length) {
+    putblock((char*)data, length);
+    crc32((const char*)data, length);
+  }
+  writeint(crc32_finalize());
+}
+
+static uint32_t *listing_crcs;
+static unsigned int listing_entries;
+
+// CRC32 of the file 'name' in 'path'
+uint32_t file_crc32(const char *path, const char *name) {
+  uint32_t result = 0;
+  unsigned int length;
+  unsigned int pathlength = strlen(path);
+  uint8_t mosfh;
+
+  if(pathlength + 1 + strlen(name) < sizeof(send_path)) {
+    strcpy(send_path, path);
+    send_path[pathlength] = '/';
+    strcpy(send_path + pathlength + 1, name);
+    mosfh = mos_fopen(send_path, FA_READ);
+    if(mosfh) {
+      crc32_initialize();
+      while((length = mos_fread(mosfh, (char*)send_buffer, YMODEM_PACKET_1K_SIZE)) > 0) crc32((char*)send_buffer, length);
+      result = crc32_finalize();
+      mos_fclose(mosfh);
     }
-    else writeint(remaining);
+  }
+  return result;
+}
 
-    filename_length = strlen(filelist[filenumber]);
-    writeint(filename_length);
-    strcpy(filename, filelist[filenumber]);
-    putblock(filename, filename_length);  // send filename
-    filesize = getfilesize(mosfh);
-  
-    unsigned int write_len;
-    writeint(filesize);
+// First pass over a listing: its size and, with 'withcrc', the CRC32 of each entry in listing_crcs.
+// Runs before the transfer starts, as the link would sit idle while files are read.
+// Returns 0 if the directory can't be read.
+uint32_t scan_listing(const char *path, bool withcrc) {
+  uint32_t filesize = 1;
+  uint32_t *crcs;
+
+  listing_entries = 0;
+  if(ffs_dopen(&send_dirs[0], path) != 0) return 0;
+  while((ffs_dread(&send_dirs[0], &send_fileinfo) == 0) && send_fileinfo.fname[0]) {
+    filesize += 4 + 1 + (withcrc ? 4 : 0) + 1 + strlen(send_fileinfo.fname);
+    if(!withcrc) continue;
+    if((listing_entries % 32) == 0) {
+      crcs = realloc(listing_crcs, (listing_entries + 32) * sizeof(uint32_t));
+      if(crcs == NULL) continue;  // the entry goes out without a CRC
+      listing_crcs = crcs;
+    }
+    listing_crcs[listing_entries++] = (send_fileinfo.fattrib & AM_DIR) ? 0 : file_crc32(path, send_fileinfo.fname);
+  }
+  ffs_dclose(&send_dirs[0]);
+  return filesize;
+}
 
-    while(filesize) {
-      write_len = mos_fread(mosfh, (char*)buffer, YMODEM_PACKET_1K_SIZE);
-      putblock((char*)buffer, write_len);
-      crc32((char*)buffer, write_len);
-      filesize -= write_len;
+// Sends a listing of 'path' as a file named SERVER_LISTING_NAME: a flags byte, then per entry
+// the size (4 bytes), attributes (1), with SERVER_LIST_CRC the CRC32 of a file (4), the length
+// of the name (1) and the name. 'filesize' and the CRCs come from scan_listing().
+void send_listing(const char *path, bool withcrc, uint32_t filesize, unsigned int remaining) {
+  uint8_t record[10 + sizeof(send_fileinfo.fname)];
+  uint8_t flags = withcrc ? SERVER_LIST_CRC : 0;
+  unsigned int length, namelength, n;
+  unsigned int entry = 0;
+
+  send_header(SERVER_LISTING_NAME, filesize, remaining);
+  putblock((char*)&flags, 1);
+  crc32((char*)&flags, 1);
+  filesize--;
+  if(ffs_dopen(&send_dirs[0], path) == 0) {
+    while((ffs_dread(&send_dirs[0], &send_fileinfo) == 0) && send_fileinfo.fname[0]) {
+      namelength = strlen(send_fileinfo.fname);
+      length = 4 + 1 + (withcrc ? 4 : 0) + 1 + namelength;
+      if(filesize < length) continue;  // entries added since the first pass are left out
+
+      putint(record, send_fileinfo.fsize);
+      record[4] = send_fileinfo.fattrib;
+      n = 5;
+      if(withcrc) {
+        putint(record + n, (entry < listing_entries) ? listing_crcs[entry] : 0);
+        n += 4;
+      }
+      record[n++] = namelength;
+      memcpy(record + n, send_fileinfo.fname, namelength);
+      putblock((char*)record, length);
+      crc32((char*)record, length);
+      filesize -= length;
+      entry++;
     }
-    writeint(crc32_finalize());
-    mos_fclose(mosfh);
+    ffs_dclose(&send_dirs[0]);
+  }
+  record[0] = 0;
+  while(filesize) {  // entries removed since the first pass, padded with empty names
+    putch(0);
+    crc32((char*)record, 1);
+    filesize--;
+  }
+  writeint(crc32_finalize());
+}
+
+// Offset of the name a command line argument is sent under: its last component, as the PC's
+// FileWalker does. The contents of ".", ".." or the root are sent relative to the directory itself.
+unsigned int name_offset(const char *path) {
+  unsigned int length = strlen(path);
+  unsigned int start;
+
+  while((length > 1) && (path[length-1] == '/')) length--;
+  start = length;
+  while((start > 0) && (path[start-1] != '/')) start--;
+  if((length - start == 0) || ((length - start == 1) && (path[start] == '.')) ||
+     ((length - start == 2) && (strncmp(path + start, "..", 2) == 0))) {
+    return length + ((path[length-1] == '/') ? 0 : 1);
+  }
+  return start;
+}
+
+// Joins a path given to the server to the server directory 'dir', which ends with '/'.
+// Absolute paths are taken as they are. False if the result doesn't fit.
+bool server_path(char *buffer, const char *dir, const char *path) {
+  if((path[0] == '/') || strchr(path, ':')) dir = "";
+  if(strlen(dir) + strlen(path) > MAXDIRLENGTH+MAXNAMELENGTH) return false;
+  strcpy(buffer, dir);
+  strcat(buffer, path);
+  return true;
+}
+
+// Sends the files and directories in 'filelist', relative ones below 'dir'
+void send_files(int filecount, char *filelist[], const char *dir) {
+  unsigned int remaining;
+  bool ok = true;
+
+  remaining = filecount;
+  send_skipped = 0;
+
+  if(!set_VDP_ymodem(YMODEM_SEND)) return; 
 
+  for(int filenumber = 0; (filenumber < filecount) && ok; filenumber++) {
+    server_path(send_path, dir, filelist[filenumber]);  // names were checked against MAXNAMELENGTH
+    if(mos_isdirectory(send_path) == 0) {
+      send_namestart = name_offset(send_path);
+      ok = send_directory(0, remaining);
+    }
+    else ok = send_file(send_path, send_path + name_offset(send_path), remaining);
     remaining--;
   }
 
+  if(!ok) {
+    printf("Error MOS\r\n");
+    return;
+  }
   writeint(0);
   getbyte();
+  if(send_skipped) printf("%u entries skipped\r\n", send_skipped);
 }
 
 char *get_base_dir(char *path) {
@@ -238,10 +603,123 @@ char *get_base_dir(char *path) {
     return path; // no slash found
 }
 
+// Runs filesystem operations, one per line: "rm path", "mkdir path" or "mv from to", relative paths below 'dir'.
+// The results go back in one file, SERVER_RESULT_NAME, a byte per operation: 0 or the MOS error.
+void server_operations(char *command, const char *dir) {
+  static uint8_t results[SERVER_MAXOPS];
+  static char frompath[MAXDIRLENGTH+MAXNAMELENGTH+1];
+  static char topath[MAXDIRLENGTH+MAXNAMELENGTH+1];
+  unsigned int count = 0;
+  char *line = command;
+
+  while(line && *line && (count < SERVER_MAXOPS)) {
+    char *next = strchr(line, '\n');
+    if(next) *next++ = 0;
+
+    char *op = strtok(line, " \t\r");
+    char *from = strtok(NULL, " \t\r");
+    char *to = strtok(NULL, " \t\r");
+    if(op) {
+      uint8_t result = SERVER_BAD_OPERATION;
+      if(from && !server_path(frompath, dir, from)) from = NULL;
+      if(to && !server_path(topath, dir, to)) to = NULL;
+      if((strcmp(op, "rm") == 0) && from) result = mos_del(frompath);
+      else if((strcmp(op, "mkdir") == 0) && from) result = mos_mkdir(frompath);
+      else if((strcmp(op, "mv") == 0) && from && to) result = mos_ren(frompath, topath);
+      if(strcmp(op, "mkdir") != 0) lastdir[0] = 0;  // the directory make_parent_dirs() knows may be gone
+      results[count++] = result;
+    }
+    line = next;
+  }
+  printf("%u operation%s\r\n", count, (count == 1) ? "" : "s");
+  if(!set_VDP_ymodem(YMODEM_SEND)) return;
+  send_memory(SERVER_RESULT_NAME, results, count, 1);
+  writeint(0);
+  getbyte();
+}
+
+// Runs one server command: "send name1 [name2 ...]", "list [-c] [directory]", "receive", "exit",
+// or lines of filesystem operations. Relative paths are below the server directory 'dir'.
+// Returns false on exit.
+bool server_command(char *command, const char *dir) {
+  static char path[MAXDIRLENGTH+MAXNAMELENGTH+1];
+  char *argv[SERVER_MAXARGS];
+  int argc = 0;
+  int count = 0;
+  char word[8];
+
+  if(sscanf(command, " %7s", word) != 1) return true;
+  if((strcmp(word, "rm") == 0) || (strcmp(word, "mkdir") == 0) || (strcmp(word, "mv") == 0)) {
+    server_operations(command, dir);
+    return true;
+  }
+
+  for(char *p = strtok(command, " \t\r\n"); p && (argc < SERVER_MAXARGS); p = strtok(NULL, " \t\r\n")) argv[argc++] = p;
+  if(argc == 0) return true;
+
+  if(strcmp(argv[0], "exit") == 0) return false;
+  if(strcmp(argv[0], "receive") == 0) return true;  // the next batch is received anyway
+  if(strcmp(argv[0], "list") == 0) {
+    bool withcrc = (argc > 1) && (strcmp(argv[1], "-c") == 0);
+    if(argc > 1 + withcrc) {
+      if(!server_path(path, dir, argv[1 + withcrc])) path[0] = 0;
+    }
+    else strcpy(path, dir);
+    printf("Listing %s\r\n", path);
+    uint32_t filesize = scan_listing(path, withcrc);
+    if(!set_VDP_ymodem(YMODEM_SEND)) return true;
+    if(filesize) send_listing(path, withcrc, filesize, 1);  // an empty batch if the directory can't be read
+    writeint(0);
+    getbyte();
+    return true;
+  }
+  if(strcmp(argv[0], "send") == 0) {
+    // Names that don't exist are left out, as one would end the batch
+    for(int i = 1; i < argc; i++) {
+      if((strlen(argv[i]) > MAXNAMELENGTH) || !server_path(path, dir, argv[i])) {
+        printf("'%s' - name too large\r\n", argv[i]);
+        continue;
+      }
+      if(mos_isdirectory(path) != 0) {
+        uint8_t mosfh = mos_fopen(path, FA_READ);
+        if(mosfh == 0) {
+          printf("'%s' does not exist\r\n", argv[i]);
+          continue;
+        }
+        mos_fclose(mosfh);
+      }
+      argv[count++] = argv[i];
+    }
+    printf("Sending %d\r\n", count);
+    send_files(count, argv, dir);
+    return true;
+  }
+  printf("Unknown command '%s'\r\n", argv[0]);
+  return true;
+}
+
+// Receives batches until a command to exit. Any batch may carry a command for the
+// server, which runs after its files have been stored.
+void serve(const char *path) {
+  static char command[SERVER_COMMAND_LENGTH];
+  int filenumber;
+
+  printf("Server mode, stopped by an 'exit' command from the PC\r\n");
+  while(1) {
+    command[0] = 0;
+    filenumber = get_files(path, command);
+    if(filenumber) printf("%d file%s received\r\n", filenumber, (filenumber == 1) ? "" : "s");
+    if(!server_command(command, path)) break;
+  }
+  printf("Server stopped\r\n");
+}
+
 void usage(void) {
   printf("Usage:\n");
   printf("  ymodem -r [directory]       Receive mode, optional target directory\n");
-  printf("  ymodem -s file1 [file2 ...] Send mode, at least one file required\n");
+  printf("  ymodem -s [-R] file1 [file2 ...] Send mode, at least one file required\n");
+  printf("  ymodem -d [directory]       Server mode, receives batches and commands until told to exit\n");
+  printf("  -R  Send directories recursively\n");
 }
 
 int main(int argc, char **argv) {
@@ -251,17 +729,26 @@ int main(int argc, char **argv) {
   int filenamecount = 0;
   bool send = false;
   bool receive = false;
+  bool server = false;
+  bool recursive = false;
 
-  while ((opt = getopt(argc, argv, "srh")) != -1) {
+  while ((opt = getopt(argc, argv, "srdRh")) != -1) {
       switch(opt) {
         case 's':
-          if(receive) { usage(); return 0;}
+          if(receive || server) { usage(); return 0;}
           send = true;
           break;
         case 'r':
-          if(send) { usage(); return 0;}
+          if(send || server) { usage(); return 0;}
           receive = true;
           break;
+        case 'd':
+          if(send || receive) { usage(); return 0;}
+          server = true;
+          break;
+        case 'R':
+          recursive = true;
+          break;
         case 'h':
         default:
           usage();
@@ -269,7 +756,8 @@ int main(int argc, char **argv) {
       }
   }
 
-  if(!send && !receive) { usage(); return 0;}
+  if(!send && !receive && !server) { usage(); return 0;}
+  if(recursive && !send) { usage(); return 0;}
 
   sysvar_init();
 
@@ -282,14 +770,14 @@ int main(int argc, char **argv) {
       return 0;
     }
 
-    if(!check_files(filecount, filenames)) {
+    if(!check_files(filecount, filenames, recursive)) {
       printf("Send aborted\r\n");
       return 0;
     }
-    send_files(filecount, filenames);
+    send_files(filecount, filenames, "");
   }
 
-  if(receive) {
+  if(receive || server) {
     if(filecount > 1) {
       usage();
       return 0;
@@ -307,7 +795,8 @@ int main(int argc, char **argv) {
     }
     else strcpy(dir, "./");
 
-    filenumber = get_files(dir);
+    if(server) serve(dir);
+    else filenumber = get_files(dir, NULL);
   }
 
   return 0;
@@ -0,0 +1,208 @@
+#define _DEFAULT_SOURCE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ez80.h"
+
+// Runs the Agon utility's assembly routines on a cycle counting eZ80 and reports
+// what they cost per byte, with the VDP link delivering bytes as fast as they are taken.
+
+#define CYCLES_MHZ                     18.432
+#define CYCLES_SIZE                    1024        // the YMODEM 1K block, as get_files() receives it
+#define CYCLES_STACK                   0x0B0000
+#define CYCLES_SYSVARS                 0x0BFF00
+#define CYCLES_BUFFER                  0x0A0000
+#define CYCLES_GETBYTE_CALLS           64
+
+static uint32_t sysvar_keyascii;
+static uint32_t sysvar_vkeycount;
+static uint32_t mos_sysvars;
+
+// The VDP link: a byte arrives the moment the program polls for one, while any are left
+static const uint8_t *rx_data;
+static uint32_t rx_length;
+static uint32_t rx_arrived;
+static uint32_t rx_taken;
+static uint8_t *tx_data;
+static uint32_t tx_length;
+
+static int peek(ez80_t *cpu, uint32_t address) {
+  (void)cpu;
+  if(address == CYCLES_SYSVARS + sysvar_vkeycount) {
+    if((rx_arrived == rx_taken) && (rx_arrived < rx_length)) rx_arrived++;
+    return rx_arrived & 0xFF;
+  }
+  if(address == CYCLES_SYSVARS + sysvar_keyascii) {
+    if(rx_taken < rx_arrived) rx_taken++;
+    return rx_taken ? rx_data[rx_taken - 1] : 0;
+  }
+  return -1;
+}
+
+// MOS API calls the routines make; the cycles of MOS itself aren't counted
+static bool rst(ez80_t *cpu, uint8_t vector) {
+  if((vector == 0x08) && (cpu->a == mos_sysvars)) {
+    cpu->ix = CYCLES_SYSVARS;
+    return true;
+  }
+  if(vector == 0x10) {
+    tx_data[tx_length++] = cpu->a;
+    return true;
+  }
+  return false;
+}
+
+static void receive_from(const uint8_t *data, uint32_t length) {
+  rx_data = data;
+  rx_length = length;
+  rx_arrived = 0;
+  rx_taken = 0;
+}
+
+static uint32_t crc32_host(const uint8_t *data, uint32_t length) {
+  uint32_t crc = 0xFFFFFFFF;
+
+  while(length--) {
+    crc ^= *data++;
+    for(int bit = 0; bit < 8; bit++) crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : (crc >> 1);
+  }
+  return ~crc;
+}
+
+static void fail(const char *message) {
+  fprintf(stderr, "%s\n", message);
+  exit(1);
+}
+
+static uint64_t call(ez80_t *cpu, const char *name, int argc, const uint32_t *argv, uint32_t *result) {
+  uint64_t start = cpu->cycles;
+
+  if(!ez80_call(cpu, name, argc, argv, result)) exit(1);
+  return cpu->cycles - start;
+}
+
+typedef struct {
+  uint64_t getblock;
+  uint64_t putblock;
+  uint64_t crc32;
+  uint64_t receive;   // getblock and crc32 of the same packet, as get_files() does
+} run_t;
+
+// One call of each routine on 'size' bytes, checking their results
+static run_t run(ez80_t *cpu, const uint8_t *data, uint32_t size) {
+  uint32_t args[2] = {CYCLES_BUFFER, size};
+  uint32_t result;
+  run_t r;
+
+  memset(cpu->memory + CYCLES_BUFFER, 0, size);
+  receive_from(data, size);
+  r.getblock = call(cpu, "_getblock", 2, args, NULL);
+  if(memcmp(cpu->memory + CYCLES_BUFFER, data, size) != 0) fail("_getblock stored the wrong data");
+
+  tx_length = 0;
+  r.putblock = call(cpu, "_putblock", 2, args, NULL);
+  if((tx_length != size) || (memcmp(tx_data, data, size) != 0)) fail("_putblock sent the wrong data");
+
+  call(cpu, "_crc32_initialize", 0, NULL, NULL);
+  r.crc32 = call(cpu, "_crc32", 2, args, NULL);
+  call(cpu, "_crc32_finalize", 0, NULL, &result);
+  if(result != crc32_host(data, size)) fail("_crc32 calculated the wrong CRC");
+
+  receive_from(data, size);
+  call(cpu, "_crc32_initialize", 0, NULL, NULL);
+  r.receive = call(cpu, "_getblock", 2, args, NULL);
+  r.receive += call(cpu, "_crc32", 2, args, NULL);
+  return r;
+}
+
+// Fixed cost per call and cost per byte, from runs on 'size' and twice as many bytes
+static void report(const char *name, uint64_t once, uint64_t twice, uint32_t size, double mhz, const char *note) {
+  double perbyte = (double)(twice - once) / size;
+  double overhead = once - perbyte * size;
+
+  printf("%-14s %10llu %9.2f %9.0f %9.1f%s%s\n", name, (unsigned long long)once, perbyte, overhead,
+         mhz * 1e6 / (once / (double)size) / 1024, *note ? "  " : "", note);
+}
+
+static void usage(const char *progname) {
+  printf("Usage:\n");
+  printf("  %s [--src directory] [--size bytes] [--mhz n] [--profile]\n", progname);
+  printf("  --src directory   Agon sources with serial.asm and crc32.asm, default ../agon/src\n");
+  printf("  --size bytes      Block size per call, default %u\n", CYCLES_SIZE);
+  printf("  --mhz n           eZ80 clock for the throughput column, default %.3f\n", CYCLES_MHZ);
+  printf("  --profile         Cycles per source line, for the calls on 'size' bytes\n");
+}
+
+int main(int argc, char **argv) {
+  const char *src = "../agon/src";
+  uint32_t size = CYCLES_SIZE;
+  double mhz = CYCLES_MHZ;
+  bool profile = false;
+  char path[1024];
+  int n;
+
+  for(n = 1; n < argc; n++) {
+    if((strcmp(argv[n], "--src") == 0) && (n + 1 < argc)) src = argv[++n];
+    else if((strcmp(argv[n], "--size") == 0) && (n + 1 < argc)) size = strtoul(argv[++n], NULL, 0);
+    else if((strcmp(argv[n], "--mhz") == 0) && (n + 1 < argc)) mhz = atof(argv[++n]);
+    else if(strcmp(argv[n], "--profile") == 0) profile = true;
+    else { usage(argv[0]); return 1; }
+  }
+  if((size == 0) || (size > (CYCLES_STACK - CYCLES_BUFFER) / 2) || (mhz <= 0)) { usage(argv[0]); return 1; }
+
+  ez80_t *cpu = ez80_create();
+  if(!cpu) fail("Out of memory");
+  snprintf(path, sizeof(path), "%s/serial.asm", src);
+  if(!ez80_load(cpu, path, "include")) return 1;
+  snprintf(path, sizeof(path), "%s/crc32.asm", src);
+  if(!ez80_load(cpu, path, "include")) return 1;
+  if(!ez80_symbol(cpu, "sysvar_keyascii", &sysvar_keyascii) || !ez80_symbol(cpu, "sysvar_vkeycount", &sysvar_vkeycount) ||
+     !ez80_symbol(cpu, "mos_sysvars", &mos_sysvars)) fail("MOS sysvar definitions missing");
+
+  cpu->peek = peek;
+  cpu->rst = rst;
+  cpu->sp = CYCLES_STACK;
+
+  uint8_t *data = malloc(2 * size);
+  tx_data = malloc(2 * size);
+  if(!data || !tx_data) fail("Out of memory");
+  srand(1);
+  for(uint32_t i = 0; i < 2 * size; i++) data[i] = (uint8_t)rand();
+
+  receive_from(NULL, 0);
+  call(cpu, "_sysvar_init", 0, NULL, NULL);
+
+  receive_from(data, CYCLES_GETBYTE_CALLS);
+  uint64_t getbyte = 0;
+  for(int i = 0; i < CYCLES_GETBYTE_CALLS; i++) {
+    getbyte += call(cpu, "_getbyte", 0, NULL, NULL);
+    if(cpu->a != data[i]) fail("_getbyte returned the wrong byte");  // uint8_t results are in A
+  }
+
+  run_t twice = run(cpu, data, 2 * size);
+  ez80_profile_reset(cpu);
+  run_t once = run(cpu, data, size);
+
+  printf("eZ80 at %.3f MHz in ADL mode, no wait states, link bytes always ready\n", mhz);
+  printf("%-14s %10s %9s %9s %9s\n", "routine", "cycles", "per byte", "per call", "KiB/s");
+  printf("%-14s %10llu %9s %9s %9.1f\n", "_getbyte", (unsigned long long)(getbyte / CYCLES_GETBYTE_CALLS), "", "",
+         mhz * 1e6 / ((double)getbyte / CYCLES_GETBYTE_CALLS) / 1024);
+  report("_getblock", once.getblock, twice.getblock, size, mhz, "");
+  report("_putblock", once.putblock, twice.putblock, size, mhz, "MOS rst 10h not counted");
+  report("_crc32", once.crc32, twice.crc32, size, mhz, "");
+  report("receive path", once.receive, twice.receive, size, mhz, "_getblock and _crc32 of each packet");
+  printf("%u byte blocks; per byte and per call are from blocks of %u and %u bytes\n", size, size, 2 * size);
+
+  if(profile) {
+    printf("\n");
+    ez80_profile_print(cpu, stdout);
+  }
+
+  free(data);
+  free(tx_data);
+  ez80_destroy(cpu);
+  return 0;
+}
@@ -0,0 +1,89 @@
+#define _XOPEN_SOURCE 700
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include "emu.h"
+
+emu_t emu = {-1, EMU_BYTE_NS, EMU_SD_WRITE_US, EMU_SD_KIB_US, 0, 0, 0, 0, 0};
+
+int agon_main(int argc, char **argv);  // main() of src/agon/src/main.c
+
+static void usage(const char *progname) {
+  printf("Usage:\n");
+  printf("  %s [options] -- ymodem arguments   Runs the Agon ymodem utility with its VDP link on a pty\n", progname);
+  printf("  --root directory   Host directory that is the SD card root, default the current directory\n");
+  printf("  --link path        Symlink to the pty, for the VDP side to open, default /tmp/agon-emu\n");
+  printf("  --byte-ns n        Link time per byte in ns, default %u\n", EMU_BYTE_NS);
+  printf("  --sd-write-us n    SD time per write call in us, default %u\n", EMU_SD_WRITE_US);
+  printf("  --sd-kib-us n      SD time per KiB written in us, default %u\n", EMU_SD_KIB_US);
+}
+
+static int open_link(const char *linkpath) {
+  struct termios tio;
+
+  int fd = posix_openpt(O_RDWR | O_NOCTTY);
+  if((fd < 0) || (grantpt(fd) != 0) || (unlockpt(fd) != 0)) return -1;
+  if(tcgetattr(fd, &tio) == 0) {
+    cfmakeraw(&tio);
+    tcsetattr(fd, TCSANOW, &tio);
+  }
+
+  unlink(linkpath);
+  if(symlink(ptsname(fd), linkpath) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int main(int argc, char **argv) {
+  const char *root = ".";
+  const char *linkpath = "/tmp/agon-emu";
+  bool separated = false;
+  int n;
+
+  // No getopt here, the Agon utility brings its own
+  for(n = 1; n < argc; n++) {
+    if(strcmp(argv[n], "--") == 0) { n++; separated = true; break; }
+    if(n + 1 >= argc) { usage(argv[0]); return 1; }
+    if(strcmp(argv[n], "--root") == 0) root = argv[++n];
+    else if(strcmp(argv[n], "--link") == 0) linkpath = argv[++n];
+    else if(strcmp(argv[n], "--byte-ns") == 0) emu.byte_ns = atoi(argv[++n]);
+    else if(strcmp(argv[n], "--sd-write-us") == 0) emu.sd_write_us = atoi(argv[++n]);
+    else if(strcmp(argv[n], "--sd-kib-us") == 0) emu.sd_kib_us = atoi(argv[++n]);
+    else { usage(argv[0]); return 1; }
+  }
+  if(!separated) { usage(argv[0]); return 1; }
+
+  emu.link = open_link(linkpath);
+  if(emu.link < 0) {
+    printf("Error %i creating the link: %s\n", errno, strerror(errno));
+    return 1;
+  }
+  if(chdir(root) != 0) {
+    printf("Error %i opening root \'%s\': %s\n", errno, root, strerror(errno));
+    return 1;
+  }
+  printf("VDP link on %s\n", linkpath);
+  fflush(stdout);
+
+  // The utility sees argv[0] as its name and the arguments after '--'
+  argv[n - 1] = "ymodem";
+  uint64_t start = emu_nanos();
+  int result = agon_main(argc - n + 1, &argv[n - 1]);
+  double seconds = (emu_nanos() - start) / 1e9;
+
+  fflush(stdout);
+  fprintf(stderr, "%.3fs, link %llu bytes in, %llu out, SD %llu writes of %llu bytes, %llu seeks\n", seconds,
+          (unsigned long long)emu.link_rx, (unsigned long long)emu.link_tx,
+          (unsigned long long)emu.sd_writes, (unsigned long long)emu.sd_written, (unsigned long long)emu.sd_seeks);
+  unlink(linkpath);
+  return result;
+}
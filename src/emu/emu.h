@@ -0,0 +1,30 @@
+#ifndef EMU_H
+#define EMU_H
+
+#include <stdint.h>
+
+// Costs of the emulated hardware, the defaults model the VDP link and a typical SD card
+#define EMU_BYTE_NS                    8680  // ns per byte on the VDP link, 10 bits at 1152000 baud
+#define EMU_SD_WRITE_US                300   // us per mos_fwrite() call
+#define EMU_SD_KIB_US                  500   // us per KiB written
+
+typedef struct {
+  int link;                 // the VDP side of the link, a pty
+  uint32_t byte_ns;
+  uint32_t sd_write_us;
+  uint32_t sd_kib_us;
+
+  // Counted while the Agon program runs
+  uint64_t link_rx;
+  uint64_t link_tx;
+  uint64_t sd_writes;
+  uint64_t sd_written;
+  uint64_t sd_seeks;
+} emu_t;
+
+extern emu_t emu;
+
+uint64_t emu_nanos(void);
+void emu_wait_until(uint64_t deadline_ns);  // sleeps, then spins for the last part
+
+#endif
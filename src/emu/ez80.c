@@ -0,0 +1,1184 @@
+#define _DEFAULT_SOURCE
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ez80.h"
+
+#define EZ80_LINE_LENGTH               256
+#define EZ80_MAX_INCLUDE_DEPTH         8
+
+#define FLAG_C                         0x01
+#define FLAG_N                         0x02
+#define FLAG_PV                        0x04
+#define FLAG_H                         0x10
+#define FLAG_Z                         0x40
+#define FLAG_S                         0x80
+
+#define MASK24                         0xFFFFFF
+
+enum { SEC_TEXT, SEC_RODATA, SEC_DATA, SEC_BSS, SEC_ABS, SEC_COUNT = SEC_ABS };
+
+enum { R_B, R_C, R_D, R_E, R_H, R_L, R_A };
+enum { RR_BC, RR_DE, RR_HL, RR_SP, RR_IX, RR_IY, RR_AF, RR_AF_ };
+enum { CC_NZ, CC_Z, CC_NC, CC_C, CC_PO, CC_PE, CC_P, CC_M };
+
+typedef enum {
+  ARG_NONE,
+  ARG_R8,
+  ARG_R24,
+  ARG_IND,     // (BC), (DE), (HL), (SP)
+  ARG_IDX,     // (IX+d), (IY+d)
+  ARG_MEM,     // (Mmn)
+  ARG_IMM,
+  ARG_COND
+} argkind_t;
+
+typedef enum {
+  OP_LD, OP_PUSH, OP_POP, OP_EX, OP_EXX,
+  OP_ADD, OP_ADC, OP_SUB, OP_SBC, OP_AND, OP_XOR, OP_OR, OP_CP,
+  OP_INC, OP_DEC,
+  OP_RLC, OP_RRC, OP_RL, OP_RR, OP_SLA, OP_SRA, OP_SRL,
+  OP_CPL, OP_NEG, OP_SCF, OP_CCF, OP_NOP,
+  OP_JR, OP_JP, OP_DJNZ, OP_CALL, OP_RET, OP_RST,
+  OP_COUNT
+} opcode_t;
+
+static const char *mnemonics[OP_COUNT] = {
+  "ld", "push", "pop", "ex", "exx",
+  "add", "adc", "sub", "sbc", "and", "xor", "or", "cp",
+  "inc", "dec",
+  "rlc", "rrc", "rl", "rr", "sla", "sra", "srl",
+  "cpl", "neg", "scf", "ccf", "nop",
+  "jr", "jp", "djnz", "call", "ret", "rst"
+};
+static const char *r8_names[] = {"b", "c", "d", "e", "h", "l", "a"};
+static const char *r24_names[] = {"bc", "de", "hl", "sp", "ix", "iy", "af", "af'"};
+static const char *cc_names[] = {"nz", "z", "nc", "c", "po", "pe", "p", "m"};
+
+typedef struct {
+  argkind_t kind;
+  int reg;
+  int32_t value;
+  char *expr;      // resolved into value once the source is placed
+} arg_t;
+
+typedef struct {
+  opcode_t op;
+  int argc;
+  arg_t arg[2];
+  uint8_t cycles;
+  uint8_t taken;   // cycles of a branch that is taken
+  int unit;
+  int line;
+  char *text;
+  uint64_t count;
+  uint64_t spent;
+} ins_t;
+
+typedef struct {
+  char *name;
+  int unit;
+  int section;
+  uint32_t value;  // instruction address, offset in the section, or the value of an .equ
+  char *expr;      // .equ, evaluated on first use
+  bool global;
+  bool busy;
+} symbol_t;
+
+typedef struct {
+  int unit;
+  int section;
+  uint32_t offset;
+  int width;
+  char *expr;
+  int line;
+} fixup_t;
+
+typedef struct {
+  char *path;
+  uint8_t *bytes[SEC_COUNT];
+  uint32_t size[SEC_COUNT];
+  uint32_t align[SEC_COUNT];
+  uint32_t base[SEC_COUNT];
+} unit_t;
+
+struct ez80_program {
+  ins_t *code;
+  size_t codelength;
+  symbol_t *symbols;
+  size_t symbolcount;
+  fixup_t *fixups;
+  size_t fixupcount;
+  unit_t *units;
+  int unitcount;
+  uint32_t next_data;
+};
+
+// Assembler state of the source being loaded
+typedef struct {
+  ez80_program_t *p;
+  int unit;
+  int section;
+  const char *includedir;
+  const char *file;
+  int line;
+  bool ended;
+} source_t;
+
+static bool failed(const source_t *s, const char *message, const char *detail) {
+  fprintf(stderr, "%s:%d: %s%s%s\n", s->file, s->line, message, detail ? " " : "", detail ? detail : "");
+  return false;
+}
+
+static void *grow(void *array, size_t count, size_t size) {
+  if(count && ((count < 16) || (count & (count - 1)))) return array;  // room left until the next power of two
+  void *p = realloc(array, (count ? 2 * count : 16) * size);
+  if(!p) {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+  return p;
+}
+
+static char *trim(char *s) {
+  while(isspace((unsigned char)*s)) s++;
+  char *end = s + strlen(s);
+  while((end > s) && isspace((unsigned char)end[-1])) *--end = 0;
+  return s;
+}
+
+static void lower(char *s) {
+  for(; *s; s++) *s = tolower((unsigned char)*s);
+}
+
+static int lookup(const char *name, const char **names, int count) {
+  for(int n = 0; n < count; n++) {
+    if(strcasecmp(name, names[n]) == 0) return n;
+  }
+  return -1;
+}
+
+static bool is_identifier(int c, bool first) {
+  return isalpha(c) || (c == '_') || (c == '.') || (!first && (isdigit(c) || (c == '$')));
+}
+
+// Symbols
+
+static symbol_t *find_symbol(ez80_program_t *p, int unit, const char *name) {
+  symbol_t *global = NULL;
+
+  for(size_t n = 0; n < p->symbolcount; n++) {
+    symbol_t *sym = &p->symbols[n];
+    if(strcmp(sym->name, name) != 0) continue;
+    if(sym->unit == unit) return sym;
+    if(sym->global && (sym->section != SEC_ABS)) global = sym;
+  }
+  return global;
+}
+
+static symbol_t *add_symbol(ez80_program_t *p, int unit, const char *name) {
+  p->symbols = grow(p->symbols, p->symbolcount, sizeof(symbol_t));
+  symbol_t *sym = &p->symbols[p->symbolcount++];
+  memset(sym, 0, sizeof(*sym));
+  sym->name = strdup(name);
+  sym->unit = unit;
+  sym->section = -1;  // declared with .global, not defined yet
+  return sym;
+}
+
+static bool define(source_t *s, const char *name, int section, uint32_t value, const char *expr) {
+  symbol_t *sym = find_symbol(s->p, s->unit, name);
+
+  if(isdigit((unsigned char)name[0])) sym = NULL;  // local labels are defined any number of times
+  else if(sym && (sym->unit != s->unit)) sym = NULL;
+  if(sym && (sym->section >= 0)) return failed(s, "Symbol defined twice:", name);
+  if(!sym) sym = add_symbol(s->p, s->unit, name);
+  sym->section = section;
+  sym->value = value;
+  sym->expr = expr ? strdup(expr) : NULL;
+  return true;
+}
+
+// Expressions are sums of numbers and symbols. Local labels are referenced as 1b and 1f,
+// relative to the instruction at 'address'.
+static bool evaluate(ez80_program_t *p, int unit, const char *expr, uint32_t address, int32_t *value);
+
+static bool symbol_value(ez80_program_t *p, int unit, const char *name, uint32_t address, int32_t *value) {
+  size_t length = strlen(name);
+
+  if(isdigit((unsigned char)name[0]) && ((name[length - 1] == 'b') || (name[length - 1] == 'f'))) {
+    bool back = (name[length - 1] == 'b');
+    bool found = false;
+    uint32_t best = 0;
+
+    for(size_t n = 0; n < p->symbolcount; n++) {
+      symbol_t *sym = &p->symbols[n];
+      if((sym->unit != unit) || (sym->section != SEC_TEXT) || (strncmp(sym->name, name, length - 1) != 0) || sym->name[length - 1]) continue;
+      if(back ? (sym->value > address) : (sym->value <= address)) continue;
+      if(!found || (back ? (sym->value > best) : (sym->value < best))) best = sym->value;
+      found = true;
+    }
+    *value = (int32_t)best;
+    return found;
+  }
+
+  symbol_t *sym = find_symbol(p, unit, name);
+  if(!sym || (sym->section < 0)) return false;
+  if(sym->section == SEC_ABS) {
+    if(sym->busy) return false;  // defined in terms of itself
+    sym->busy = true;
+    bool ok = evaluate(p, sym->unit, sym->expr, address, value);
+    sym->busy = false;
+    return ok;
+  }
+  if(sym->section == SEC_TEXT) *value = (int32_t)sym->value;
+  else *value = (int32_t)(p->units[sym->unit].base[sym->section] + sym->value);
+  return true;
+}
+
+static bool number(const char *s, int32_t *value) {
+  char *end;
+  size_t length = strlen(s);
+  unsigned long v;
+
+  if(s[0] == '$') v = strtoul(s + 1, &end, 16);
+  else if(s[0] == '%') v = strtoul(s + 1, &end, 2);
+  else if((s[0] == '0') && ((s[1] == 'x') || (s[1] == 'X'))) v = strtoul(s + 2, &end, 16);
+  else if((s[0] == '0') && ((s[1] == 'b') || (s[1] == 'B')) && s[2]) v = strtoul(s + 2, &end, 2);
+  else if((length > 1) && ((s[length - 1] == 'h') || (s[length - 1] == 'H'))) {
+    v = strtoul(s, &end, 16);
+    if(end != s + length - 1) return false;
+    end++;
+  }
+  else v = strtoul(s, &end, 10);
+  *value = (int32_t)v;
+  return (*end == 0) && (end != s);
+}
+
+static bool evaluate(ez80_program_t *p, int unit, const char *expr, uint32_t address, int32_t *value) {
+  char term[EZ80_LINE_LENGTH];
+  int32_t total = 0;
+  int sign = 1;
+  const char *s = expr;
+
+  while(1) {
+    while(isspace((unsigned char)*s)) s++;
+    if(*s == '-') { sign = -sign; s++; continue; }
+    if(*s == '+') { s++; continue; }
+
+    size_t length = 0;
+    while(s[length] && (s[length] != '+') && (s[length] != '-') && !isspace((unsigned char)s[length])) length++;
+    if((length == 0) || (length >= sizeof(term))) return false;
+    memcpy(term, s, length);
+    term[length] = 0;
+    s += length;
+
+    int32_t v;
+    bool local = isdigit((unsigned char)term[0]) && ((term[length - 1] == 'b') || (term[length - 1] == 'f'));
+    if(local || (!isdigit((unsigned char)term[0]) && (term[0] != '$') && (term[0] != '%'))) {
+      if(!symbol_value(p, unit, term, address, &v)) return false;
+    }
+    else if(!number(term, &v)) return false;
+    total += sign * v;
+    sign = 1;
+
+    while(isspace((unsigned char)*s)) s++;
+    if(*s == 0) break;
+    if((*s != '+') && (*s != '-')) return false;
+  }
+  *value = total;
+  return true;
+}
+
+// Operands
+
+static bool parse_arg(source_t *s, char *text, arg_t *arg, bool condition) {
+  char buffer[EZ80_LINE_LENGTH];
+  int n;
+
+  memset(arg, 0, sizeof(*arg));
+  text = trim(text);
+  if(condition && ((n = lookup(text, cc_names, 8)) >= 0)) {
+    arg->kind = ARG_COND;
+    arg->reg = n;
+    return true;
+  }
+  if((n = lookup(text, r8_names, 7)) >= 0) {
+    arg->kind = ARG_R8;
+    arg->reg = n;
+    return true;
+  }
+  if((n = lookup(text, r24_names, 8)) >= 0) {
+    arg->kind = ARG_R24;
+    arg->reg = n;
+    return true;
+  }
+
+  size_t length = strlen(text);
+  if((text[0] == '(') && (text[length - 1] == ')')) {
+    snprintf(buffer, sizeof(buffer), "%.*s", (int)length - 2, text + 1);
+    char *inner = trim(buffer);
+
+    if(((n = lookup(inner, r24_names, 4)) >= 0)) {
+      arg->kind = ARG_IND;
+      arg->reg = n;
+      return true;
+    }
+    if(((strncasecmp(inner, "ix", 2) == 0) || (strncasecmp(inner, "iy", 2) == 0)) && !is_identifier(inner[2], false)) {
+      char *offset = trim(inner + 2);
+      arg->kind = ARG_IDX;
+      arg->reg = (tolower((unsigned char)inner[1]) == 'x') ? RR_IX : RR_IY;
+      if(*offset && (*offset != '+') && (*offset != '-')) return failed(s, "Bad index:", text);
+      arg->expr = strdup(*offset ? offset : "0");
+      return true;
+    }
+    arg->kind = ARG_MEM;
+    arg->expr = strdup(inner);
+    return true;
+  }
+  if(length == 0) return failed(s, "Missing operand", NULL);
+  arg->kind = ARG_IMM;
+  arg->expr = strdup(text);
+  return true;
+}
+
+// Cycles in ADL mode without wait states, after the instruction summary of the eZ80 CPU user manual.
+// Returns false for a form the eZ80 doesn't have.
+static bool timing(ins_t *ins) {
+  argkind_t k0 = ins->arg[0].kind, k1 = ins->arg[1].kind;
+  int r0 = ins->arg[0].reg, r1 = ins->arg[1].reg;
+  bool x0 = (k0 == ARG_R24) && ((r0 == RR_IX) || (r0 == RR_IY));
+  bool x1 = (k1 == ARG_R24) && ((r1 == RR_IX) || (r1 == RR_IY));
+  bool pair0 = (k0 == ARG_R24) && (r0 <= RR_SP);
+  bool pair1 = (k1 == ARG_R24) && (r1 <= RR_SP);
+  int c = 0, taken = 0;
+
+  switch(ins->op) {
+    case OP_LD:
+      if((k0 == ARG_R8) && (k1 == ARG_R8)) c = 1;
+      else if((k0 == ARG_R8) && (k1 == ARG_IMM)) c = 2;
+      else if((k0 == ARG_R8) && (k1 == ARG_IND) && ((r1 == RR_HL) || (r0 == R_A && r1 != RR_SP))) c = 2;
+      else if((k0 == ARG_IND) && (k1 == ARG_R8) && ((r0 == RR_HL) || (r1 == R_A && r0 != RR_SP))) c = 2;
+      else if((k0 == ARG_IND) && (r0 == RR_HL) && (k1 == ARG_IMM)) c = 3;
+      else if((k0 == ARG_R8) && (k1 == ARG_IDX)) c = 4;
+      else if((k0 == ARG_IDX) && (k1 == ARG_R8)) c = 4;
+      else if((k0 == ARG_IDX) && (k1 == ARG_IMM)) c = 5;
+      else if((k0 == ARG_R8) && (r0 == R_A) && (k1 == ARG_MEM)) c = 5;
+      else if((k0 == ARG_MEM) && (k1 == ARG_R8) && (r1 == R_A)) c = 5;
+      else if(pair0 && (k1 == ARG_IMM)) c = 4;
+      else if(x0 && (k1 == ARG_IMM)) c = 5;
+      else if((k0 == ARG_R24) && (r0 == RR_HL) && (k1 == ARG_MEM)) c = 7;
+      else if((k0 == ARG_MEM) && (k1 == ARG_R24) && (r1 == RR_HL)) c = 7;
+      else if((pair0 || x0) && (k1 == ARG_MEM)) c = 8;
+      else if((k0 == ARG_MEM) && (pair1 || x1)) c = 8;
+      else if((pair0 || x0) && (r0 != RR_SP) && (k1 == ARG_IND) && (r1 == RR_HL)) c = 5;
+      else if((k0 == ARG_IND) && (r0 == RR_HL) && (pair1 || x1) && (r1 != RR_SP)) c = 5;
+      else if((pair0 || x0) && (r0 != RR_SP) && (k1 == ARG_IDX)) c = 6;
+      else if((k0 == ARG_IDX) && (pair1 || x1) && (r1 != RR_SP)) c = 6;
+      else if((k0 == ARG_R24) && (r0 == RR_SP) && (k1 == ARG_R24) && (r1 == RR_HL)) c = 1;
+      else if((k0 == ARG_R24) && (r0 == RR_SP) && x1) c = 2;
+      break;
+    case OP_PUSH:
+    case OP_POP:
+      if((k0 == ARG_R24) && (r0 != RR_SP) && (r0 != RR_AF_)) c = x0 ? 5 : 4;
+      break;
+    case OP_EX:
+      if((k0 == ARG_R24) && (r0 == RR_DE) && (k1 == ARG_R24) && (r1 == RR_HL)) c = 1;
+      else if((k0 == ARG_R24) && (r0 == RR_AF) && (k1 == ARG_R24) && (r1 == RR_AF_)) c = 1;
+      break;
+    case OP_ADD:
+    case OP_ADC:
+    case OP_SBC:
+      if(ins->argc == 2) {
+        if((k0 == ARG_R24) && (r0 == RR_HL) && pair1) c = (ins->op == OP_ADD) ? 1 : 2;
+        else if(x0 && (ins->op == OP_ADD) && (((k1 == ARG_R24) && ((r1 == RR_BC) || (r1 == RR_DE) || (r1 == RR_SP))) || (k1 == ARG_R24 && r1 == r0))) c = 2;
+        break;
+      }
+      // fall through
+    case OP_SUB:
+    case OP_AND:
+    case OP_XOR:
+    case OP_OR:
+    case OP_CP:
+      if(ins->argc != 1) break;
+      if(k0 == ARG_R8) c = 1;
+      else if(k0 == ARG_IMM) c = 2;
+      else if((k0 == ARG_IND) && (r0 == RR_HL)) c = 2;
+      else if(k0 == ARG_IDX) c = 4;
+      break;
+    case OP_INC:
+    case OP_DEC:
+      if(k0 == ARG_R8) c = 1;
+      else if((k0 == ARG_IND) && (r0 == RR_HL)) c = 4;
+      else if(k0 == ARG_IDX) c = 6;
+      else if(pair0) c = 1;
+      else if(x0) c = 2;
+      break;
+    case OP_RLC: case OP_RRC: case OP_RL: case OP_RR: case OP_SLA: case OP_SRA: case OP_SRL:
+      if(k0 == ARG_R8) c = 2;
+      else if((k0 == ARG_IND) && (r0 == RR_HL)) c = 5;
+      else if(k0 == ARG_IDX) c = 7;
+      break;
+    case OP_EXX: case OP_CPL: case OP_SCF: case OP_CCF: case OP_NOP:
+      if(ins->argc == 0) c = 1;
+      break;
+    case OP_NEG:
+      if(ins->argc == 0) c = 2;
+      break;
+    case OP_JR:
+      if((ins->argc == 1) && (k0 == ARG_IMM)) c = 3;
+      else if((k0 == ARG_COND) && (r0 <= CC_C) && (k1 == ARG_IMM)) { c = 2; taken = 3; }
+      break;
+    case OP_DJNZ:
+      if(k0 == ARG_IMM) { c = 2; taken = 4; }
+      break;
+    case OP_JP:
+      if((ins->argc == 1) && (k0 == ARG_IMM)) c = 5;
+      else if((ins->argc == 1) && (k0 == ARG_IND) && (r0 == RR_HL)) c = 3;
+      else if((ins->argc == 1) && (k0 == ARG_IDX)) c = 4;
+      else if((k0 == ARG_COND) && (k1 == ARG_IMM)) { c = 4; taken = 5; }
+      break;
+    case OP_CALL:
+      if((ins->argc == 1) && (k0 == ARG_IMM)) c = 7;
+      else if((k0 == ARG_COND) && (k1 == ARG_IMM)) { c = 4; taken = 7; }
+      break;
+    case OP_RET:
+      if(ins->argc == 0) c = 6;
+      else if((ins->argc == 1) && (k0 == ARG_COND)) { c = 2; taken = 6; }
+      break;
+    case OP_RST:
+      if(k0 == ARG_IMM) c = 6;
+      break;
+    default:
+      break;
+  }
+  if(c == 0) return false;
+  ins->cycles = (uint8_t)c;
+  ins->taken = (uint8_t)(taken ? taken : c);
+  return true;
+}
+
+static bool instruction(source_t *s, char *mnemonic, char **args, int argc, const char *text) {
+  ez80_program_t *p = s->p;
+  char *suffix = strchr(mnemonic, '.');
+  int op;
+
+  if(suffix) *suffix++ = 0;
+  if((op = lookup(mnemonic, mnemonics, OP_COUNT)) < 0) return failed(s, "Unknown instruction:", mnemonic);
+  if(s->section != SEC_TEXT) return failed(s, "Instruction outside .text:", mnemonic);
+  if(argc > 2) return failed(s, "Too many operands:", text);
+
+  p->code = grow(p->code, p->codelength, sizeof(ins_t));
+  ins_t *ins = &p->code[p->codelength];
+  memset(ins, 0, sizeof(*ins));
+  ins->op = (opcode_t)op;
+  ins->unit = s->unit;
+  ins->line = s->line;
+  ins->text = strdup(text);
+
+  bool branch = (op == OP_JR) || (op == OP_JP) || (op == OP_CALL) || (op == OP_RET);
+  for(int n = 0; n < argc; n++) {
+    if(!parse_arg(s, args[n], &ins->arg[n], branch && (n == 0) && ((argc == 2) || (op == OP_RET)))) return false;
+  }
+  ins->argc = argc;
+
+  // 'or a, a' is 'or a'
+  bool alu = (op == OP_SUB) || (op == OP_AND) || (op == OP_XOR) || (op == OP_OR) || (op == OP_CP) ||
+             (((op == OP_ADD) || (op == OP_ADC) || (op == OP_SBC)) && (ins->arg[0].kind == ARG_R8));
+  if(alu && (argc == 2) && (ins->arg[0].kind == ARG_R8) && (ins->arg[0].reg == R_A)) {
+    ins->arg[0] = ins->arg[1];
+    memset(&ins->arg[1], 0, sizeof(arg_t));
+    ins->argc = 1;
+  }
+  if(!timing(ins)) return failed(s, "Not an eZ80 instruction:", text);
+  if(suffix) {  // .lil and friends are a prefix byte
+    ins->cycles++;
+    ins->taken++;
+  }
+  p->codelength++;
+  return true;
+}
+
+// Data
+
+static void emit(source_t *s, const uint8_t *data, uint32_t length) {
+  unit_t *u = &s->p->units[s->unit];
+  int sec = s->section;
+
+  if(sec != SEC_BSS) {
+    uint8_t *bytes = realloc(u->bytes[sec], u->size[sec] + length);
+    if(!bytes) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+    u->bytes[sec] = bytes;
+    if(data) memcpy(bytes + u->size[sec], data, length);
+    else memset(bytes + u->size[sec], 0, length);
+  }
+  u->size[sec] += length;
+}
+
+static bool data(source_t *s, char **args, int argc, int width) {
+  ez80_program_t *p = s->p;
+
+  if(s->section == SEC_TEXT) return failed(s, "Data in .text is not supported", NULL);
+  for(int n = 0; n < argc; n++) {
+    p->fixups = grow(p->fixups, p->fixupcount, sizeof(fixup_t));
+    fixup_t *f = &p->fixups[p->fixupcount++];
+    f->unit = s->unit;
+    f->section = s->section;
+    f->offset = p->units[s->unit].size[s->section];
+    f->width = width;
+    f->expr = strdup(trim(args[n]));
+    f->line = s->line;
+    emit(s, NULL, width);
+  }
+  return true;
+}
+
+static bool constant(source_t *s, const char *expr, int32_t *value) {
+  if(!evaluate(s->p, s->unit, expr, 0, value)) return failed(s, "Bad value:", expr);
+  return true;
+}
+
+static bool load_file(source_t *s, const char *path, int depth);
+
+static bool directive(source_t *s, char *name, char **args, int argc, char *rest) {
+  unit_t *u = &s->p->units[s->unit];
+  int32_t value;
+
+  lower(name);
+  if((strcmp(name, ".assume") == 0) || (strcmp(name, ".extern") == 0)) return true;
+  if((strcmp(name, ".global") == 0) || (strcmp(name, ".globl") == 0)) {
+    for(int n = 0; n < argc; n++) {
+      char *sym = trim(args[n]);
+      symbol_t *found = find_symbol(s->p, s->unit, sym);
+      if(!found || (found->unit != s->unit)) found = add_symbol(s->p, s->unit, sym);
+      found->global = true;
+    }
+    return true;
+  }
+  if(strcmp(name, ".include") == 0) {
+    char path[EZ80_LINE_LENGTH * 2];
+    char *file = trim(rest);
+    size_t length = strlen(file);
+
+    if((length < 2) || (file[0] != '"') || (file[length - 1] != '"')) return failed(s, "Bad include:", file);
+    file[length - 1] = 0;
+    snprintf(path, sizeof(path), "%s/%s", s->includedir, file + 1);
+    return load_file(s, path, 1);
+  }
+  if((strcmp(name, ".section") == 0) && (argc >= 1)) {
+    name = trim(args[0]);
+    lower(name);
+  }
+  if(strcmp(name, ".text") == 0) { s->section = SEC_TEXT; return true; }
+  if(strcmp(name, ".rodata") == 0) { s->section = SEC_RODATA; return true; }
+  if(strcmp(name, ".data") == 0) { s->section = SEC_DATA; return true; }
+  if(strcmp(name, ".bss") == 0) { s->section = SEC_BSS; return true; }
+  if(strcmp(name, ".section") == 0) return failed(s, "Unknown section:", rest);
+
+  if(((strcmp(name, ".equ") == 0) || (strcmp(name, ".set") == 0)) && (argc == 2)) {
+    return define(s, trim(args[0]), SEC_ABS, 0, trim(args[1]));
+  }
+  if((strcmp(name, ".align") == 0) && (argc >= 1)) {
+    if(!constant(s, args[0], &value) || (value < 0) || (value > 16)) return failed(s, "Bad alignment", NULL);
+    if(s->section == SEC_TEXT) return true;  // instructions are numbered, not placed
+    uint32_t align = 1u << value;
+    uint32_t size = u->size[s->section];
+    if(align > u->align[s->section]) u->align[s->section] = align;
+    emit(s, NULL, ((size + align - 1) & ~(align - 1)) - size);
+    return true;
+  }
+  if(((strcmp(name, ".space") == 0) || (strcmp(name, ".ds") == 0) || (strcmp(name, ".skip") == 0)) && (argc >= 1)) {
+    if(s->section == SEC_TEXT) return failed(s, "Data in .text is not supported", NULL);
+    if(!constant(s, args[0], &value) || (value < 0)) return false;
+    emit(s, NULL, (uint32_t)value);
+    return true;
+  }
+  if((strcmp(name, ".db") == 0) || (strcmp(name, ".byte") == 0) || (strcmp(name, ".d8") == 0)) return data(s, args, argc, 1);
+  if((strcmp(name, ".dw") == 0) || (strcmp(name, ".d16") == 0) || (strcmp(name, ".short") == 0)) return data(s, args, argc, 2);
+  if((strcmp(name, ".dl") == 0) || (strcmp(name, ".d24") == 0)) return data(s, args, argc, 3);
+  if((strcmp(name, ".d32") == 0) || (strcmp(name, ".long") == 0)) return data(s, args, argc, 4);
+  return failed(s, "Unsupported directive:", name);
+}
+
+// Splits operands at commas outside of parentheses and quotes
+static int split(char *text, char **args, int max) {
+  int argc = 0, depth = 0;
+  bool quoted = false;
+
+  if(*trim(text) == 0) return 0;
+  args[argc++] = text;
+  for(char *p = text; *p; p++) {
+    if(*p == '"') quoted = !quoted;
+    else if(quoted) continue;
+    else if(*p == '(') depth++;
+    else if(*p == ')') depth--;
+    else if((*p == ',') && (depth == 0)) {
+      *p = 0;
+      if(argc == max) return max + 1;
+      args[argc++] = p + 1;
+    }
+  }
+  return argc;
+}
+
+static bool parse_line(source_t *s, char *line) {
+  char text[EZ80_LINE_LENGTH];
+  char rest[EZ80_LINE_LENGTH];
+  char *args[16];
+  char *comment = strchr(line, ';');
+
+  if(comment) *comment = 0;
+  line = trim(line);
+
+  // Labels, also 'name: equ value'
+  char *p = line;
+  while(*p && (is_identifier((unsigned char)*p, p == line) || isdigit((unsigned char)*p))) p++;
+  if((p > line) && (*p == ':')) {
+    *p = 0;
+    char *label = line;
+    line = trim(p + 1);
+    if(strncasecmp(line, "equ", 3) == 0 && isspace((unsigned char)line[3])) return define(s, label, SEC_ABS, 0, trim(line + 4));
+    if(s->section == SEC_TEXT) {
+      if(!define(s, label, SEC_TEXT, EZ80_CODE_BASE + s->p->codelength, NULL)) return false;
+    }
+    else if(!define(s, label, s->section, s->p->units[s->unit].size[s->section], NULL)) return false;
+  }
+  if(*line == 0) return true;
+  if(strcasecmp(line, "end") == 0) {
+    s->ended = true;
+    return true;
+  }
+
+  snprintf(text, sizeof(text), "%s", line);
+  char *word = line;
+  while(*line && !isspace((unsigned char)*line)) line++;
+  if(*line) *line++ = 0;
+  snprintf(rest, sizeof(rest), "%s", line);
+
+  // 'name equ value'
+  char *second = trim(line);
+  if((strncasecmp(second, "equ", 3) == 0) && isspace((unsigned char)second[3])) return define(s, word, SEC_ABS, 0, trim(second + 4));
+
+  int argc = split(second, args, 16);
+  if(argc > 16) return failed(s, "Too many operands", NULL);
+  if(word[0] == '.') return directive(s, word, args, argc, rest);
+  return instruction(s, word, args, argc, text);
+}
+
+static bool load_file(source_t *s, const char *path, int depth) {
+  char line[EZ80_LINE_LENGTH];
+  const char *file = s->file;
+  int number = s->line;
+  bool ok = true;
+
+  if(depth > EZ80_MAX_INCLUDE_DEPTH) return failed(s, "Includes nested too deep:", path);
+  FILE *f = fopen(path, "r");
+  if(!f) {
+    if(file) return failed(s, "Can't open", path);
+    fprintf(stderr, "Can't open %s\n", path);
+    return false;
+  }
+  s->file = path;
+  s->line = 0;
+  while(ok && !s->ended && fgets(line, sizeof(line), f)) {
+    s->line++;
+    ok = parse_line(s, line);
+  }
+  fclose(f);
+  s->file = file;
+  s->line = number;
+  s->ended = false;
+  return ok;
+}
+
+// Places the data sections of the unit and resolves everything that refers to addresses
+static bool place(ez80_t *cpu, int unit) {
+  ez80_program_t *p = cpu->program;
+  unit_t *u = &p->units[unit];
+  source_t s = {p, unit, SEC_TEXT, NULL, u->path, 0, false};
+
+  for(int sec = SEC_RODATA; sec < SEC_COUNT; sec++) {
+    uint32_t align = u->align[sec];
+    u->base[sec] = (p->next_data + align - 1) & ~(align - 1);
+    p->next_data = u->base[sec] + u->size[sec];
+    if(p->next_data > EZ80_MEMORY) return failed(&s, "Data doesn't fit in memory", NULL);
+    if(u->bytes[sec]) memcpy(cpu->memory + u->base[sec], u->bytes[sec], u->size[sec]);
+  }
+
+  for(size_t n = 0; n < p->fixupcount; n++) {
+    fixup_t *f = &p->fixups[n];
+    int32_t value;
+
+    if(f->unit != unit) continue;
+    s.line = f->line;
+    if(!evaluate(p, unit, f->expr, 0, &value)) return failed(&s, "Undefined value:", f->expr);
+    for(int b = 0; b < f->width; b++) cpu->memory[u->base[f->section] + f->offset + b] = (uint8_t)(value >> (8 * b));
+  }
+
+  for(size_t n = 0; n < p->codelength; n++) {
+    ins_t *ins = &p->code[n];
+
+    if(ins->unit != unit) continue;
+    s.line = ins->line;
+    for(int a = 0; a < ins->argc; a++) {
+      arg_t *arg = &ins->arg[a];
+      if(arg->expr && !evaluate(p, unit, arg->expr, EZ80_CODE_BASE + n, &arg->value)) return failed(&s, "Undefined value:", arg->expr);
+    }
+  }
+  return true;
+}
+
+bool ez80_load(ez80_t *cpu, const char *path, const char *includedir) {
+  ez80_program_t *p = cpu->program;
+
+  p->units = grow(p->units, p->unitcount, sizeof(unit_t));
+  unit_t *u = &p->units[p->unitcount];
+  memset(u, 0, sizeof(*u));
+  u->path = strdup(path);
+  for(int sec = 0; sec < SEC_COUNT; sec++) u->align[sec] = 1;
+
+  source_t s = {p, p->unitcount++, SEC_TEXT, includedir, NULL, 0, false};
+  if(!load_file(&s, path, 0)) return false;
+  return place(cpu, s.unit);
+}
+
+bool ez80_symbol(ez80_t *cpu, const char *name, uint32_t *value) {
+  ez80_program_t *p = cpu->program;
+  int32_t v;
+
+  for(int unit = 0; unit < p->unitcount; unit++) {
+    if(symbol_value(p, unit, name, 0, &v)) {
+      *value = (uint32_t)v & MASK24;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Execution
+
+static uint8_t read8(ez80_t *cpu, uint32_t address) {
+  address &= MASK24;
+  if(cpu->peek) {
+    int value = cpu->peek(cpu, address);
+    if(value >= 0) return (uint8_t)value;
+  }
+  return cpu->memory[address];
+}
+
+static uint32_t read24(ez80_t *cpu, uint32_t address) {
+  return read8(cpu, address) | (read8(cpu, address + 1) << 8) | ((uint32_t)read8(cpu, address + 2) << 16);
+}
+
+static void write8(ez80_t *cpu, uint32_t address, uint8_t value) {
+  cpu->memory[address & MASK24] = value;
+}
+
+static void write24(ez80_t *cpu, uint32_t address, uint32_t value) {
+  write8(cpu, address, (uint8_t)value);
+  write8(cpu, address + 1, (uint8_t)(value >> 8));
+  write8(cpu, address + 2, (uint8_t)(value >> 16));
+}
+
+static void push(ez80_t *cpu, uint32_t value) {
+  cpu->sp = (cpu->sp - 3) & MASK24;
+  write24(cpu, cpu->sp, value);
+}
+
+static uint32_t pop(ez80_t *cpu) {
+  uint32_t value = read24(cpu, cpu->sp);
+  cpu->sp = (cpu->sp + 3) & MASK24;
+  return value;
+}
+
+static uint32_t *pair(ez80_t *cpu, int reg) {
+  switch(reg) {
+    case RR_BC: return &cpu->bc;
+    case RR_DE: return &cpu->de;
+    case RR_HL: return &cpu->hl;
+    case RR_SP: return &cpu->sp;
+    case RR_IX: return &cpu->ix;
+    default:    return &cpu->iy;
+  }
+}
+
+static uint32_t get24(ez80_t *cpu, int reg) {
+  if(reg == RR_AF) return ((uint32_t)cpu->a << 8) | cpu->f;
+  return *pair(cpu, reg);
+}
+
+static void set24(ez80_t *cpu, int reg, uint32_t value) {
+  if(reg == RR_AF) {
+    cpu->a = (uint8_t)(value >> 8);
+    cpu->f = (uint8_t)value;
+  }
+  else *pair(cpu, reg) = value & MASK24;
+}
+
+static uint8_t get8(ez80_t *cpu, int reg) {
+  switch(reg) {
+    case R_B: return (uint8_t)(cpu->bc >> 8);
+    case R_C: return (uint8_t)cpu->bc;
+    case R_D: return (uint8_t)(cpu->de >> 8);
+    case R_E: return (uint8_t)cpu->de;
+    case R_H: return (uint8_t)(cpu->hl >> 8);
+    case R_L: return (uint8_t)cpu->hl;
+    default:  return cpu->a;
+  }
+}
+
+static void set8(ez80_t *cpu, int reg, uint8_t value) {
+  switch(reg) {
+    case R_B: cpu->bc = (cpu->bc & 0xFF00FF) | (value << 8); break;
+    case R_C: cpu->bc = (cpu->bc & 0xFFFF00) | value; break;
+    case R_D: cpu->de = (cpu->de & 0xFF00FF) | (value << 8); break;
+    case R_E: cpu->de = (cpu->de & 0xFFFF00) | value; break;
+    case R_H: cpu->hl = (cpu->hl & 0xFF00FF) | (value << 8); break;
+    case R_L: cpu->hl = (cpu->hl & 0xFFFF00) | value; break;
+    default:  cpu->a = value; break;
+  }
+}
+
+static uint32_t address_of(ez80_t *cpu, const arg_t *arg) {
+  switch(arg->kind) {
+    case ARG_IND: return get24(cpu, arg->reg);
+    case ARG_IDX: return (get24(cpu, arg->reg) + arg->value) & MASK24;
+    default:      return (uint32_t)arg->value & MASK24;
+  }
+}
+
+static uint8_t load8(ez80_t *cpu, const arg_t *arg) {
+  if(arg->kind == ARG_R8) return get8(cpu, arg->reg);
+  if(arg->kind == ARG_IMM) return (uint8_t)arg->value;
+  return read8(cpu, address_of(cpu, arg));
+}
+
+static void store8(ez80_t *cpu, const arg_t *arg, uint8_t value) {
+  if(arg->kind == ARG_R8) set8(cpu, arg->reg, value);
+  else write8(cpu, address_of(cpu, arg), value);
+}
+
+static uint8_t parity(uint8_t value) {
+  value ^= value >> 4;
+  value ^= value >> 2;
+  value ^= value >> 1;
+  return (value & 1) ? 0 : FLAG_PV;
+}
+
+static uint8_t sz(uint8_t value) {
+  return (value & 0x80) | (value ? 0 : FLAG_Z);
+}
+
+static void alu8(ez80_t *cpu, opcode_t op, uint8_t v) {
+  uint8_t a = cpu->a;
+  unsigned carry = cpu->f & FLAG_C;
+  unsigned r;
+
+  switch(op) {
+    case OP_ADD:
+    case OP_ADC:
+      r = a + v + ((op == OP_ADC) ? carry : 0);
+      cpu->a = (uint8_t)r;
+      cpu->f = sz((uint8_t)r) | ((r > 0xFF) ? FLAG_C : 0) | ((~(a ^ v) & (a ^ r) & 0x80) ? FLAG_PV : 0) | ((a ^ v ^ r) & FLAG_H);
+      break;
+    case OP_SUB:
+    case OP_SBC:
+    case OP_CP:
+      r = a - v - ((op == OP_SBC) ? carry : 0);
+      if(op != OP_CP) cpu->a = (uint8_t)r;
+      cpu->f = sz((uint8_t)r) | ((r > 0xFF) ? FLAG_C : 0) | (((a ^ v) & (a ^ r) & 0x80) ? FLAG_PV : 0) | ((a ^ v ^ r) & FLAG_H) | FLAG_N;
+      break;
+    case OP_AND: cpu->a = a & v; cpu->f = sz(cpu->a) | parity(cpu->a) | FLAG_H; break;
+    case OP_XOR: cpu->a = a ^ v; cpu->f = sz(cpu->a) | parity(cpu->a); break;
+    case OP_OR:  cpu->a = a | v; cpu->f = sz(cpu->a) | parity(cpu->a); break;
+    default: break;
+  }
+}
+
+static void alu24(ez80_t *cpu, opcode_t op, int reg, uint32_t v) {
+  uint32_t hl = get24(cpu, reg);
+  uint32_t carry = cpu->f & FLAG_C;
+  uint32_t r;
+
+  if(op == OP_ADD) {
+    r = hl + v;
+    cpu->f = (cpu->f & (FLAG_S | FLAG_Z | FLAG_PV)) | ((r > MASK24) ? FLAG_C : 0);
+  }
+  else if(op == OP_ADC) {
+    r = hl + v + carry;
+    cpu->f = ((r & 0x800000) ? FLAG_S : 0) | ((r & MASK24) ? 0 : FLAG_Z) | ((r > MASK24) ? FLAG_C : 0) |
+             ((~(hl ^ v) & (hl ^ r) & 0x800000) ? FLAG_PV : 0);
+  }
+  else {
+    r = hl - v - carry;
+    cpu->f = ((r & 0x800000) ? FLAG_S : 0) | ((r & MASK24) ? 0 : FLAG_Z) | ((hl < v + carry) ? FLAG_C : 0) |
+             (((hl ^ v) & (hl ^ r) & 0x800000) ? FLAG_PV : 0) | FLAG_N;
+  }
+  set24(cpu, reg, r);
+}
+
+static uint8_t shift(ez80_t *cpu, opcode_t op, uint8_t v) {
+  uint8_t carry = cpu->f & FLAG_C;
+  uint8_t out, r;
+
+  switch(op) {
+    case OP_RLC: out = v >> 7; r = (uint8_t)((v << 1) | out); break;
+    case OP_RRC: out = v & 1;  r = (uint8_t)((v >> 1) | (out << 7)); break;
+    case OP_RL:  out = v >> 7; r = (uint8_t)((v << 1) | carry); break;
+    case OP_RR:  out = v & 1;  r = (uint8_t)((v >> 1) | (carry << 7)); break;
+    case OP_SLA: out = v >> 7; r = (uint8_t)(v << 1); break;
+    case OP_SRA: out = v & 1;  r = (uint8_t)((v >> 1) | (v & 0x80)); break;
+    default:     out = v & 1;  r = (uint8_t)(v >> 1); break;
+  }
+  cpu->f = sz(r) | parity(r) | (out ? FLAG_C : 0);
+  return r;
+}
+
+static bool condition(ez80_t *cpu, int cc) {
+  switch(cc) {
+    case CC_NZ: return !(cpu->f & FLAG_Z);
+    case CC_Z:  return cpu->f & FLAG_Z;
+    case CC_NC: return !(cpu->f & FLAG_C);
+    case CC_C:  return cpu->f & FLAG_C;
+    case CC_PO: return !(cpu->f & FLAG_PV);
+    case CC_PE: return cpu->f & FLAG_PV;
+    case CC_P:  return !(cpu->f & FLAG_S);
+    default:    return cpu->f & FLAG_S;
+  }
+}
+
+static bool fault(ez80_t *cpu, const ins_t *ins, const char *message) {
+  unit_t *u = &cpu->program->units[ins->unit];
+  fprintf(stderr, "%s:%d: %s: %s\n", u->path, ins->line, ins->text, message);
+  return false;
+}
+
+static bool step(ez80_t *cpu) {
+  ez80_program_t *p = cpu->program;
+  uint32_t index = cpu->pc - EZ80_CODE_BASE;
+
+  if(index >= p->codelength) {
+    fprintf(stderr, "Jump outside the program to %06X\n", (unsigned)cpu->pc);
+    return false;
+  }
+
+  ins_t *ins = &p->code[index];
+  const arg_t *a0 = &ins->arg[0], *a1 = &ins->arg[1];
+  uint32_t next = cpu->pc + 1;
+  bool taken = false;
+  uint8_t v;
+
+  switch(ins->op) {
+    case OP_LD:
+      if((a0->kind == ARG_R24) || (a1->kind == ARG_R24)) {
+        uint32_t value;
+        if(a1->kind == ARG_R24) value = get24(cpu, a1->reg);
+        else if(a1->kind == ARG_IMM) value = (uint32_t)a1->value;
+        else value = read24(cpu, address_of(cpu, a1));
+        if(a0->kind == ARG_R24) set24(cpu, a0->reg, value);
+        else write24(cpu, address_of(cpu, a0), value);
+      }
+      else store8(cpu, a0, load8(cpu, a1));
+      break;
+    case OP_PUSH:
+      push(cpu, get24(cpu, a0->reg));
+      break;
+    case OP_POP:
+      set24(cpu, a0->reg, pop(cpu));
+      break;
+    case OP_EX:
+      if(a0->reg == RR_DE) {
+        uint32_t t = cpu->de; cpu->de = cpu->hl; cpu->hl = t;
+      }
+      else {
+        uint8_t t = cpu->a; cpu->a = cpu->a_; cpu->a_ = t;
+        t = cpu->f; cpu->f = cpu->f_; cpu->f_ = t;
+      }
+      break;
+    case OP_EXX: {
+      uint32_t t = cpu->bc; cpu->bc = cpu->bc_; cpu->bc_ = t;
+      t = cpu->de; cpu->de = cpu->de_; cpu->de_ = t;
+      t = cpu->hl; cpu->hl = cpu->hl_; cpu->hl_ = t;
+      break;
+    }
+    case OP_ADD: case OP_ADC: case OP_SBC:
+      if(ins->argc == 2) {
+        alu24(cpu, ins->op, a0->reg, get24(cpu, a1->reg));
+        break;
+      }
+      // fall through
+    case OP_SUB: case OP_AND: case OP_XOR: case OP_OR: case OP_CP:
+      alu8(cpu, ins->op, load8(cpu, a0));
+      break;
+    case OP_INC:
+    case OP_DEC:
+      if(a0->kind == ARG_R24) set24(cpu, a0->reg, get24(cpu, a0->reg) + ((ins->op == OP_INC) ? 1 : -1));
+      else {
+        v = load8(cpu, a0) + ((ins->op == OP_INC) ? 1 : -1);
+        store8(cpu, a0, v);
+        cpu->f = (cpu->f & FLAG_C) | sz(v);
+        if(ins->op == OP_INC) cpu->f |= (v == 0x80) ? FLAG_PV : 0;
+        else cpu->f |= FLAG_N | ((v == 0x7F) ? FLAG_PV : 0);
+      }
+      break;
+    case OP_RLC: case OP_RRC: case OP_RL: case OP_RR: case OP_SLA: case OP_SRA: case OP_SRL:
+      store8(cpu, a0, shift(cpu, ins->op, load8(cpu, a0)));
+      break;
+    case OP_CPL:
+      cpu->a = ~cpu->a;
+      cpu->f |= FLAG_H | FLAG_N;
+      break;
+    case OP_NEG:
+      v = cpu->a;
+      cpu->a = 0;
+      alu8(cpu, OP_SUB, v);
+      break;
+    case OP_SCF: cpu->f = (cpu->f & ~(FLAG_H | FLAG_N)) | FLAG_C; break;
+    case OP_CCF: cpu->f = (cpu->f & ~FLAG_N) ^ FLAG_C; break;
+    case OP_NOP: break;
+    case OP_JR:
+    case OP_JP:
+    case OP_CALL:
+      if(ins->argc == 1) {
+        taken = true;
+        next = (a0->kind == ARG_IMM) ? (uint32_t)a0->value : address_of(cpu, a0);
+      }
+      else if(condition(cpu, a0->reg)) {
+        taken = true;
+        next = (uint32_t)a1->value;
+      }
+      if(taken && (ins->op == OP_CALL)) push(cpu, cpu->pc + 1);
+      break;
+    case OP_DJNZ:
+      set8(cpu, R_B, get8(cpu, R_B) - 1);
+      if(get8(cpu, R_B)) {
+        taken = true;
+        next = (uint32_t)a0->value;
+      }
+      break;
+    case OP_RET:
+      if((ins->argc == 0) || condition(cpu, a0->reg)) {
+        taken = true;
+        next = pop(cpu);
+      }
+      break;
+    case OP_RST:
+      // The handler runs on the host and returns straight away
+      cpu->rst_calls++;
+      if(!cpu->rst || !cpu->rst(cpu, (uint8_t)a0->value)) return fault(cpu, ins, "no handler for this restart");
+      break;
+    default:
+      return fault(cpu, ins, "not implemented");
+  }
+
+  unsigned cycles = taken ? ins->taken : ins->cycles;
+  cpu->cycles += cycles;
+  cpu->instructions++;
+  ins->count++;
+  ins->spent += cycles;
+  cpu->pc = next & MASK24;
+  return true;
+}
+
+bool ez80_call(ez80_t *cpu, const char *name, int argc, const uint32_t *argv, uint32_t *result) {
+  ez80_program_t *p = cpu->program;
+  symbol_t *sym = NULL;
+
+  for(size_t n = 0; n < p->symbolcount; n++) {
+    if(p->symbols[n].global && (p->symbols[n].section == SEC_TEXT) && (strcmp(p->symbols[n].name, name) == 0)) sym = &p->symbols[n];
+  }
+  if(!sym) {
+    fprintf(stderr, "No routine %s\n", name);
+    return false;
+  }
+
+  for(int n = argc - 1; n >= 0; n--) push(cpu, argv[n]);
+  push(cpu, EZ80_RETURN);
+  cpu->cycles += 7;  // the CALL itself
+  cpu->pc = sym->value;
+
+  for(uint64_t steps = 0; cpu->pc != EZ80_RETURN; steps++) {
+    if(steps == EZ80_MAX_STEPS) {
+      fprintf(stderr, "%s doesn't return\n", name);
+      return false;
+    }
+    if(!step(cpu)) return false;
+  }
+  cpu->sp = (cpu->sp + 3 * argc) & MASK24;
+  if(result) *result = (cpu->hl & MASK24) | ((cpu->de & 0xFF) << 24);
+  return true;
+}
+
+void ez80_profile_reset(ez80_t *cpu) {
+  ez80_program_t *p = cpu->program;
+
+  for(size_t n = 0; n < p->codelength; n++) {
+    p->code[n].count = 0;
+    p->code[n].spent = 0;
+  }
+}
+
+void ez80_profile_print(ez80_t *cpu, FILE *out) {
+  ez80_program_t *p = cpu->program;
+  uint64_t total = 0;
+
+  for(size_t n = 0; n < p->codelength; n++) total += p->code[n].spent;
+  if(total == 0) return;
+
+  fprintf(out, "%-28s %12s %12s %6s  %s\n", "line", "count", "cycles", "share", "instruction");
+  for(size_t n = 0; n < p->codelength; n++) {
+    ins_t *ins = &p->code[n];
+    char where[EZ80_LINE_LENGTH];
+
+    if(!ins->count) continue;
+    const char *file = strrchr(p->units[ins->unit].path, '/');
+    snprintf(where, sizeof(where), "%s:%d", file ? file + 1 : p->units[ins->unit].path, ins->line);
+    fprintf(out, "%-28s %12llu %12llu %5.1f%%  %s\n", where, (unsigned long long)ins->count,
+            (unsigned long long)ins->spent, 100.0 * ins->spent / total, ins->text);
+  }
+}
+
+ez80_t *ez80_create(void) {
+  ez80_t *cpu = calloc(1, sizeof(ez80_t));
+  if(!cpu) return NULL;
+
+  cpu->memory = calloc(1, EZ80_MEMORY);
+  cpu->program = calloc(1, sizeof(ez80_program_t));
+  if(!cpu->memory || !cpu->program) {
+    ez80_destroy(cpu);
+    return NULL;
+  }
+  cpu->program->next_data = EZ80_DATA_BASE;
+  return cpu;
+}
+
+void ez80_destroy(ez80_t *cpu) {
+  ez80_program_t *p = cpu->program;
+
+  if(p) {
+    for(size_t n = 0; n < p->codelength; n++) {
+      free(p->code[n].text);
+      for(int a = 0; a < 2; a++) free(p->code[n].arg[a].expr);
+    }
+    for(size_t n = 0; n < p->symbolcount; n++) {
+      free(p->symbols[n].name);
+      free(p->symbols[n].expr);
+    }
+    for(size_t n = 0; n < p->fixupcount; n++) free(p->fixups[n].expr);
+    for(int u = 0; u < p->unitcount; u++) {
+      free(p->units[u].path);
+      for(int sec = 0; sec < SEC_COUNT; sec++) free(p->units[u].bytes[sec]);
+    }
+    free(p->code);
+    free(p->symbols);
+    free(p->fixups);
+    free(p->units);
+    free(p);
+  }
+  free(cpu->memory);
+  free(cpu);
+}
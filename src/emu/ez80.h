@@ -0,0 +1,58 @@
+#ifndef EZ80_H
+#define EZ80_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// A cycle counting eZ80 for the Agon utility's assembly routines, in ADL mode.
+// Sources are assembled from their gnu-as text and run instruction by instruction;
+// every instruction is one address in the code space. Data sections are placed in
+// a 16 MiB memory, and the cycles of each instruction come from the instruction
+// summary of the eZ80 CPU user manual, without wait states.
+
+#define EZ80_MEMORY                    0x1000000
+#define EZ80_CODE_BASE                 0x040000  // where the instructions are numbered from
+#define EZ80_DATA_BASE                 0x050000  // data sections of all sources, in load order
+#define EZ80_RETURN                    0xFFFFFF  // return address of ez80_call()
+#define EZ80_MAX_STEPS                 100000000 // a call taking longer is stopped
+
+typedef struct ez80 ez80_t;
+typedef struct ez80_program ez80_program_t;
+
+typedef int (*ez80_peek_t)(ez80_t *cpu, uint32_t address);  // -1 for plain memory
+typedef bool (*ez80_rst_t)(ez80_t *cpu, uint8_t vector);    // runs the handler, false if it has none
+
+struct ez80 {
+  uint8_t a, f, a_, f_;
+  uint32_t bc, de, hl, bc_, de_, hl_;
+  uint32_t ix, iy, sp, pc;
+
+  uint64_t cycles;
+  uint64_t instructions;
+  uint64_t rst_calls;       // handlers run on the host, their cycles aren't counted
+
+  uint8_t *memory;
+  ez80_peek_t peek;         // memory mapped input, such as the MOS sysvars
+  ez80_rst_t rst;
+  void *user;
+
+  ez80_program_t *program;
+};
+
+ez80_t *ez80_create(void);
+void ez80_destroy(ez80_t *cpu);
+
+// Assembles a source file into the program, 'includedir' is searched for .include files
+bool ez80_load(ez80_t *cpu, const char *path, const char *includedir);
+bool ez80_symbol(ez80_t *cpu, const char *name, uint32_t *value);
+
+// Calls a global routine with the C calling convention, arguments are pushed as 24 bit values.
+// Returns false on an error, 'result' is E:HL.
+bool ez80_call(ez80_t *cpu, const char *name, int argc, const uint32_t *argv, uint32_t *result);
+
+// Cycles spent per source line since the last reset
+void ez80_profile_reset(ez80_t *cpu);
+void ez80_profile_print(ez80_t *cpu, FILE *out);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef EMU_MOS_H
+#define EMU_MOS_H
+
+// The part of the agondev MOS API the Agon utility uses, implemented on the host by mos.c
+
+#include <stdint.h>
+
+typedef uint32_t uint24_t;  // wide enough for every uint24_t value of the eZ80
+
+// FatFs values, as MOS passes them on
+#define FA_READ                        0x01
+#define FA_WRITE                       0x02
+#define FA_OPEN_EXISTING               0x00
+#define FA_CREATE_NEW                  0x04
+#define FA_CREATE_ALWAYS               0x08
+#define FA_OPEN_ALWAYS                 0x10
+#define FA_OPEN_APPEND                 0x30
+
+#define AM_RDO                         0x01
+#define AM_HID                         0x02
+#define AM_SYS                         0x04
+#define AM_DIR                         0x10
+#define AM_ARC                         0x20
+
+typedef struct {
+  uint32_t fsize;
+  uint16_t fdate;
+  uint16_t ftime;
+  uint8_t fattrib;
+  char altname[13];
+  char fname[256];
+} FILINFO;
+
+typedef struct {
+  void *handle;
+  char path[256];
+} DIR;
+
+uint8_t mos_fopen(const char *filename, uint8_t mode);  // 0 on error
+uint8_t mos_fclose(uint8_t fh);
+uint24_t mos_fread(uint8_t fh, char *buffer, uint24_t length);
+uint24_t mos_fwrite(uint8_t fh, const char *buffer, uint24_t length);
+uint8_t mos_flseek(uint8_t fh, uint32_t offset);
+uint8_t mos_del(const char *filename);
+uint8_t mos_ren(const char *source, const char *destination);
+uint8_t mos_mkdir(const char *path);
+uint8_t mos_isdirectory(const char *path);  // 0 if it is a directory
+
+int ffs_getcwd(char *buffer, int length);
+int ffs_dopen(DIR *dir, const char *path);
+int ffs_dread(DIR *dir, FILINFO *info);  // empty fname at the end
+int ffs_dclose(DIR *dir);
+
+int putch(int c);  // to the VDP
+
+#endif
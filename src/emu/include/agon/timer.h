@@ -0,0 +1 @@
+// Not used on the host
@@ -0,0 +1,131 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "agon/mos.h"
+#include "emu.h"
+#include "serial.h"
+#include "crc32.h"
+
+#define LINK_RX_BUFFER                 4096
+#define LINK_SPIN_NS                   50000  // waits shorter than this spin instead of sleeping
+
+static uint8_t rx_buffer[LINK_RX_BUFFER];
+static size_t rx_head;
+static size_t rx_tail;
+static uint64_t rx_clock;  // time the last received byte has fully arrived
+static uint64_t tx_clock;  // time the last sent byte has left
+
+uint64_t emu_nanos(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void emu_wait_until(uint64_t deadline_ns) {
+  uint64_t now = emu_nanos();
+
+  if((deadline_ns > now) && (deadline_ns - now > LINK_SPIN_NS)) {
+    uint64_t sleep = deadline_ns - now - LINK_SPIN_NS;
+    struct timespec ts = {(time_t)(sleep / 1000000000ULL), (long)(sleep % 1000000000ULL)};
+    nanosleep(&ts, NULL);
+  }
+  while(emu_nanos() < deadline_ns) ;
+}
+
+// Each direction of the link moves a byte per byte_ns, like the UART between the VDP and the eZ80
+static void link_cost(uint64_t *clock, size_t bytes) {
+  uint64_t now = emu_nanos();
+
+  if(*clock < now) *clock = now;
+  *clock += (uint64_t)bytes * emu.byte_ns;
+  emu_wait_until(*clock);
+}
+
+static void link_fail(const char *what) {
+  fprintf(stderr, "Link %s failed: %s\n", what, errno ? strerror(errno) : "closed");
+  exit(1);
+}
+
+static void link_write(const void *data, size_t length) {
+  const uint8_t *p = data;
+
+  while(length) {
+    ssize_t n = write(emu.link, p, length);
+    if(n < 0) {
+      if(errno == EINTR) continue;
+      link_fail("write");
+    }
+    link_cost(&tx_clock, n);
+    emu.link_tx += n;
+    p += n;
+    length -= n;
+  }
+}
+
+// The ez80 sees single bytes through the MOS sysvars; host reads are buffered
+static uint8_t link_read(void) {
+  if(rx_head == rx_tail) {
+    ssize_t n;
+    do n = read(emu.link, rx_buffer, sizeof(rx_buffer));
+    while((n < 0) && (errno == EINTR));
+    if(n <= 0) link_fail("read");
+    rx_head = n;
+    rx_tail = 0;
+  }
+  link_cost(&rx_clock, 1);
+  emu.link_rx++;
+  return rx_buffer[rx_tail++];
+}
+
+void sysvar_init(void) {
+  rx_head = rx_tail = 0;
+}
+
+uint8_t getbyte(void) {
+  return link_read();
+}
+
+void getblock(char *data, uint24_t length) {
+  while(length--) *data++ = (char)link_read();
+}
+
+void putblock(char *data, uint24_t length) {
+  link_write(data, length);
+}
+
+int putch(int c) {
+  uint8_t byte = (uint8_t)c;
+
+  link_write(&byte, 1);
+  return c;
+}
+
+// crc32.asm: standard CRC32 with a running, not yet inverted, result
+static uint32_t crc_table[256];
+static uint32_t crc_state;
+
+void crc32_initialize(void) {
+  if(!crc_table[1]) {
+    for(uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for(int bit = 0; bit < 8; bit++) c = (c & 1) ? (c >> 1) ^ 0xEDB88320 : (c >> 1);
+      crc_table[i] = c;
+    }
+  }
+  crc_state = 0xFFFFFFFF;
+}
+
+void crc32(const char *s, uint24_t length) {
+  while(length--) crc_state = (crc_state >> 8) ^ crc_table[(crc_state ^ (uint8_t)*s++) & 0xFF];
+}
+
+uint32_t crc32_finalize(void) {
+  crc_state = ~crc_state;
+  return crc_state;
+}
@@ -0,0 +1,172 @@
+#define _DEFAULT_SOURCE
+
+#define DIR HOST_DIR  // the MOS DIR of agon/mos.h is a different type
+#include <dirent.h>
+#undef DIR
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "agon/mos.h"
+#include "emu.h"
+
+#define MOS_FILES                      8     // open files at a time, handle 0 is an error
+
+// FatFs results, as MOS returns them
+#define FR_OK                          0
+#define FR_DISK_ERR                    1
+#define FR_NO_FILE                     4
+#define FR_NO_PATH                     5
+#define FR_DENIED                      7
+#define FR_EXIST                       8
+#define FR_TOO_MANY_OPEN_FILES         18
+
+static int files[MOS_FILES + 1];
+
+// MOS paths are relative to the SD card root, the emulator runs in the root directory
+static const char *hostpath(const char *path) {
+  while(*path == '/') path++;
+  return *path ? path : ".";
+}
+
+static uint8_t result(void) {
+  switch(errno) {
+    case ENOENT: return FR_NO_FILE;
+    case ENOTDIR: return FR_NO_PATH;
+    case EEXIST: return FR_EXIST;
+    case EACCES:
+    case EPERM:
+    case ENOTEMPTY: return FR_DENIED;
+    default: return FR_DISK_ERR;
+  }
+}
+
+uint8_t mos_fopen(const char *filename, uint8_t mode) {
+  int flags = (mode & FA_WRITE) ? ((mode & FA_READ) ? O_RDWR : O_WRONLY) : O_RDONLY;
+
+  if((mode & FA_OPEN_APPEND) == FA_OPEN_APPEND) flags |= O_CREAT | O_APPEND;
+  else if(mode & FA_CREATE_ALWAYS) flags |= O_CREAT | O_TRUNC;
+  else if(mode & FA_CREATE_NEW) flags |= O_CREAT | O_EXCL;
+  else if(mode & FA_OPEN_ALWAYS) flags |= O_CREAT;
+
+  for(uint8_t fh = 1; fh <= MOS_FILES; fh++) {
+    if(files[fh]) continue;
+    int fd = open(hostpath(filename), flags, 0644);
+    if(fd < 0) return 0;
+    files[fh] = fd + 1;
+    return fh;
+  }
+  return 0;
+}
+
+uint8_t mos_fclose(uint8_t fh) {
+  if((fh == 0) || (fh > MOS_FILES) || !files[fh]) return FR_DISK_ERR;
+  close(files[fh] - 1);
+  files[fh] = 0;
+  return FR_OK;
+}
+
+uint24_t mos_fread(uint8_t fh, char *buffer, uint24_t length) {
+  if((fh == 0) || (fh > MOS_FILES) || !files[fh]) return 0;
+  ssize_t n = read(files[fh] - 1, buffer, length);
+  return (n > 0) ? (uint24_t)n : 0;
+}
+
+// Costs the configured SD write time, per call and per KiB
+uint24_t mos_fwrite(uint8_t fh, const char *buffer, uint24_t length) {
+  uint64_t start = emu_nanos();
+
+  if((fh == 0) || (fh > MOS_FILES) || !files[fh]) return 0;
+  ssize_t n = write(files[fh] - 1, buffer, length);
+  if(n <= 0) return 0;
+
+  emu.sd_writes++;
+  emu.sd_written += n;
+  emu_wait_until(start + (uint64_t)emu.sd_write_us * 1000 + (uint64_t)n * emu.sd_kib_us * 1000 / 1024);
+  return (uint24_t)n;
+}
+
+// Like FatFs, a seek past the end of a file open for writing expands it
+uint8_t mos_flseek(uint8_t fh, uint32_t offset) {
+  struct stat st;
+
+  if((fh == 0) || (fh > MOS_FILES) || !files[fh]) return FR_DISK_ERR;
+  emu.sd_seeks++;
+  int fd = files[fh] - 1;
+  if((fstat(fd, &st) == 0) && (offset > st.st_size) && ((fcntl(fd, F_GETFL) & O_ACCMODE) != O_RDONLY)) {
+    if(ftruncate(fd, offset) != 0) return FR_DENIED;
+  }
+  return (lseek(fd, offset, SEEK_SET) == (off_t)offset) ? FR_OK : FR_DISK_ERR;
+}
+
+uint8_t mos_del(const char *filename) {
+  struct stat st;
+
+  if(stat(hostpath(filename), &st) != 0) return result();
+  if(S_ISDIR(st.st_mode)) return (rmdir(hostpath(filename)) == 0) ? FR_OK : result();
+  return (unlink(hostpath(filename)) == 0) ? FR_OK : result();
+}
+
+uint8_t mos_ren(const char *source, const char *destination) {
+  if(access(hostpath(destination), F_OK) == 0) return FR_EXIST;  // FatFs doesn't replace
+  return (rename(hostpath(source), hostpath(destination)) == 0) ? FR_OK : result();
+}
+
+uint8_t mos_mkdir(const char *path) {
+  return (mkdir(hostpath(path), 0755) == 0) ? FR_OK : result();
+}
+
+uint8_t mos_isdirectory(const char *path) {
+  struct stat st;
+
+  if(stat(hostpath(path), &st) != 0) return FR_NO_PATH;
+  return S_ISDIR(st.st_mode) ? FR_OK : FR_NO_PATH;
+}
+
+int ffs_getcwd(char *buffer, int length) {
+  if(length < 2) return FR_DISK_ERR;
+  strcpy(buffer, "/");
+  return FR_OK;
+}
+
+int ffs_dopen(DIR *dir, const char *path) {
+  snprintf(dir->path, sizeof(dir->path), "%s", hostpath(path));
+  dir->handle = opendir(dir->path);
+  return dir->handle ? FR_OK : FR_NO_PATH;
+}
+
+// FatFs doesn't return '.' and '..'
+int ffs_dread(DIR *dir, FILINFO *info) {
+  struct dirent *de;
+  struct stat st;
+  char path[512];
+
+  memset(info, 0, sizeof(*info));
+  while((de = readdir((HOST_DIR *)dir->handle)) != NULL) {
+    if((strcmp(de->d_name, ".") == 0) || (strcmp(de->d_name, "..") == 0)) continue;
+    snprintf(info->fname, sizeof(info->fname), "%s", de->d_name);
+    if((snprintf(path, sizeof(path), "%s/%s", dir->path, de->d_name) < (int)sizeof(path)) && (stat(path, &st) == 0)) {
+      info->fsize = S_ISDIR(st.st_mode) ? 0 : (uint32_t)st.st_size;
+      info->fattrib = S_ISDIR(st.st_mode) ? AM_DIR : AM_ARC;
+      if(!(st.st_mode & S_IWUSR)) info->fattrib |= AM_RDO;
+    }
+    break;
+  }
+  return FR_OK;
+}
+
+int ffs_dclose(DIR *dir) {
+  if(dir->handle) closedir((HOST_DIR *)dir->handle);
+  dir->handle = NULL;
+  return FR_OK;
+}
+
+// Size of an open file, filesize.asm reads it from the MOS FIL structure
+uint32_t getfilesize(uint8_t fh) {
+  struct stat st;
+
+  if((fh == 0) || (fh > MOS_FILES) || !files[fh]) return 0;
+  return (fstat(files[fh] - 1, &st) == 0) ? (uint32_t)st.st_size : 0;
+}
@@ -0,0 +1,230 @@
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+// Plays the VDP side of the Agon utility's packet protocol, as the VDP does for a YMODEM
+// transfer with the PC, and measures the throughput of the Agon side.
+
+#define VDP_PACKET                     1024  // data packet size, the YMODEM 1K block
+#define VDP_MAXPACKET                  1024  // largest data packet get_files() on the Agon accepts
+#define VDP_YMODEM_RECEIVE             1
+#define VDP_YMODEM_SEND                2
+
+static int link_fd;
+
+static void fail(const char *message) {
+  fprintf(stderr, "%s\n", message);
+  exit(1);
+}
+
+static void put(const void *data, size_t length) {
+  const uint8_t *p = data;
+
+  while(length) {
+    ssize_t n = write(link_fd, p, length);
+    if(n < 0) {
+      if(errno == EINTR) continue;
+      fail("Link write failed");
+    }
+    p += n;
+    length -= n;
+  }
+}
+
+static void get(void *data, size_t length) {
+  uint8_t *p = data;
+
+  while(length) {
+    ssize_t n = read(link_fd, p, length);
+    if(n < 0) {
+      if(errno == EINTR) continue;
+      fail("Link read failed");
+    }
+    if(n == 0) fail("Link closed");
+    p += n;
+    length -= n;
+  }
+}
+
+static void putint(uint32_t value) {
+  uint8_t b[4] = {(uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24)};
+  put(b, 4);
+}
+
+static uint32_t getint(void) {
+  uint8_t b[4];
+  get(b, 4);
+  return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+static void expect(char c) {
+  uint8_t sync[2];
+
+  get(sync, 2);
+  if((sync[0] != 'S') || (sync[1] != c)) {
+    fprintf(stderr, "Expected S%c, got %02X %02X\n", c, sync[0], sync[1]);
+    exit(1);
+  }
+}
+
+static uint32_t crc_table[256];
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t length) {
+  if(!crc_table[1]) {
+    for(uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for(int bit = 0; bit < 8; bit++) c = (c & 1) ? (c >> 1) ^ 0xEDB88320 : (c >> 1);
+      crc_table[i] = c;
+    }
+  }
+  crc = ~crc;
+  while(length--) crc = (crc >> 8) ^ crc_table[(crc ^ *data++) & 0xFF];
+  return ~crc;
+}
+
+static double seconds(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// VDU 23,28,direction from the Agon, answered with 'C'
+static void handshake(uint8_t direction) {
+  uint8_t vdu[3];
+
+  get(vdu, 3);
+  if((vdu[0] != 23) || (vdu[1] != 28) || (vdu[2] != direction)) fail("No ymodem request from the Agon");
+  put("C", 1);
+}
+
+// Sends 'files' files of 'size' bytes to get_files() on the Agon
+static uint64_t bench_receive(int files, uint32_t size, uint32_t packet) {
+  uint8_t *data = malloc(size ? size : 1);
+  uint8_t state;
+  uint64_t total = 0;
+  char name[32];
+
+  if(!data) fail("Out of memory");
+  handshake(VDP_YMODEM_RECEIVE);
+  for(int n = 0; n < files; n++) {
+    for(uint32_t i = 0; i < size; i++) data[i] = (uint8_t)rand();
+    snprintf(name, sizeof(name), "bench%03d.bin", n);
+
+    state = 1;
+    put(&state, 1);
+    putint(strlen(name));
+    put(name, strlen(name));
+    putint(size);
+    expect('1');
+
+    for(uint32_t offset = 0; offset < size; offset += packet) {
+      uint32_t length = (size - offset < packet) ? size - offset : packet;
+      state = 2;
+      put(&state, 1);
+      putint(length);
+      put(data + offset, length);
+      expect('2');
+    }
+
+    state = 3;
+    put(&state, 1);
+    putint(crc32_update(0, data, size));
+    expect('V');
+
+    state = 4;
+    put(&state, 1);
+    expect('4');
+    total += size;
+  }
+  state = 0;
+  put(&state, 1);
+  free(data);
+  return total;
+}
+
+// Takes the files from send_files() on the Agon and checks their CRC32
+static uint64_t bench_send(void) {
+  static uint8_t buffer[VDP_MAXPACKET];
+  char name[256];
+  uint64_t total = 0;
+
+  handshake(VDP_YMODEM_SEND);
+  while(getint() != 0) {
+    uint32_t length = getint();
+    if(length >= sizeof(name)) fail("Name too long");
+    get(name, length);
+    name[length] = 0;
+
+    uint32_t size = getint();
+    uint32_t crc = 0;
+    for(uint32_t offset = 0; offset < size; ) {
+      uint32_t chunk = (size - offset < sizeof(buffer)) ? size - offset : sizeof(buffer);
+      get(buffer, chunk);
+      crc = crc32_update(crc, buffer, chunk);
+      offset += chunk;
+    }
+    if(getint() != crc) {
+      fprintf(stderr, "%s: CRC error\n", name);
+      exit(1);
+    }
+    printf("%s %u\n", name, size);
+    total += size;
+  }
+  put("", 1);  // end of batch acknowledged
+  return total;
+}
+
+static void usage(const char *progname) {
+  printf("Usage:\n");
+  printf("  %s [--link path] [--files n] [--size bytes] [--packet bytes] receive  Sends files to 'ymodem -r' on the Agon\n", progname);
+  printf("  %s [--link path] send  Takes the files of 'ymodem -s' on the Agon\n", progname);
+}
+
+int main(int argc, char **argv) {
+  const char *linkpath = "/tmp/agon-emu";
+  int files = 10;
+  uint32_t size = 256 * 1024;
+  uint32_t packet = VDP_PACKET;
+  struct termios tio;
+  int n;
+
+  for(n = 1; (n + 1 < argc) && (strncmp(argv[n], "--", 2) == 0); n++) {
+    if(strcmp(argv[n], "--link") == 0) linkpath = argv[++n];
+    else if(strcmp(argv[n], "--files") == 0) files = atoi(argv[++n]);
+    else if(strcmp(argv[n], "--size") == 0) size = strtoul(argv[++n], NULL, 0);
+    else if(strcmp(argv[n], "--packet") == 0) packet = strtoul(argv[++n], NULL, 0);
+    else { usage(argv[0]); return 1; }
+  }
+  if((n != argc - 1) || (packet == 0) || (packet > VDP_MAXPACKET)) { usage(argv[0]); return 1; }
+
+  link_fd = open(linkpath, O_RDWR | O_NOCTTY);
+  if(link_fd < 0) {
+    printf("Error %i opening \'%s\': %s\n", errno, linkpath, strerror(errno));
+    return 1;
+  }
+  if(tcgetattr(link_fd, &tio) == 0) {
+    cfmakeraw(&tio);
+    tcsetattr(link_fd, TCSANOW, &tio);
+  }
+
+  double start = seconds();
+  uint64_t total;
+  if(strcmp(argv[n], "receive") == 0) total = bench_receive(files, size, packet);
+  else if(strcmp(argv[n], "send") == 0) total = bench_send();
+  else { usage(argv[0]); return 1; }
+  double elapsed = seconds() - start;
+
+  printf("%llu bytes in %.3fs, %.1f KiB/s\n", (unsigned long long)total, elapsed, total / elapsed / 1024);
+  close(link_fd);
+  return 0;
+}
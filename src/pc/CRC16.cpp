@@ -6,6 +6,7 @@
 
 
 #include "CRC16.h"
+#include "Crc.h"
 #include "CrcFastReverse.h"
 
 
@@ -21,7 +22,9 @@ CRC16::CRC16(uint16_t polynome,
   _reverseOut(reverseOut),
   _crc(initial),
   _count(0u)
-{}
+{
+  _selectTable();
+}
 
 void CRC16::reset(uint16_t polynome,
                   uint16_t initial,
@@ -34,6 +37,7 @@ void CRC16::reset(uint16_t polynome,
   _xorOut = xorOut;
   _reverseIn = reverseIn;
   _reverseOut = reverseOut;
+  _selectTable();
   restart();
 }
 
@@ -59,12 +63,18 @@ crc_size_t CRC16::count() const
 void CRC16::add(uint8_t value)
 {
   _count++;
-  _add(value);
+  if (_update) _crc = _update(_crc, &value, 1);
+  else _add(value);
 }
 
 void CRC16::add(const uint8_t *array, crc_size_t length)
 {
   _count += length;
+  if (_update)
+  {
+    _crc = _update(_crc, array, length);
+    return;
+  }
   while (length--)
   {
     _add(*array++);
@@ -74,6 +84,18 @@ void CRC16::add(const uint8_t *array, crc_size_t length)
 void CRC16::add(const uint8_t *array, crc_size_t length, crc_size_t yieldPeriod)
 {
   _count += length;
+  if (_update)
+  {
+    while (length)
+    {
+      crc_size_t chunk = (length < yieldPeriod) ? length : yieldPeriod;
+      _crc = _update(_crc, array, chunk);
+      array += chunk;
+      length -= chunk;
+      if (chunk == yieldPeriod) yield();
+    }
+    return;
+  }
   crc_size_t period = yieldPeriod;
   while (length--)
   {
@@ -104,6 +126,36 @@ void CRC16::_add(uint8_t value)
   }
 }
 
+//  Only the polynome and input reflection determine the table,
+//  initial value, xorOut and output reflection stay with this class.
+template <uint16_t polynome>
+static auto tableUpdate(bool reverseIn)
+{
+  return reverseIn ? &Crc<16, polynome, 0, 0, true, true>::updateUnreflected
+                   : &Crc<16, polynome, 0, 0, false, false>::updateUnreflected;
+}
+
+void CRC16::_selectTable()
+{
+  switch (_polynome)
+  {
+    case 0x8001: _update = tableUpdate<0x8001>(_reverseIn); break;
+    case 0x1021: _update = tableUpdate<0x1021>(_reverseIn); break;
+    case 0x8005: _update = tableUpdate<0x8005>(_reverseIn); break;
+    case 0xC867: _update = tableUpdate<0xC867>(_reverseIn); break;
+    case 0x0589: _update = tableUpdate<0x0589>(_reverseIn); break;
+    case 0x3D65: _update = tableUpdate<0x3D65>(_reverseIn); break;
+    case 0x8BB7: _update = tableUpdate<0x8BB7>(_reverseIn); break;
+    case 0xA097: _update = tableUpdate<0xA097>(_reverseIn); break;
+    case 0x2F15: _update = tableUpdate<0x2F15>(_reverseIn); break;
+    case 0xA02B: _update = tableUpdate<0xA02B>(_reverseIn); break;
+    case 0x5935: _update = tableUpdate<0x5935>(_reverseIn); break;
+    case 0x755B: _update = tableUpdate<0x755B>(_reverseIn); break;
+    case 0x1DCF: _update = tableUpdate<0x1DCF>(_reverseIn); break;
+    default: _update = nullptr; break;
+  }
+}
+
 uint16_t CRC16::getCRC() const
 {
   return calc();
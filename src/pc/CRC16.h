@@ -31,10 +31,10 @@ public:
   void add(const uint8_t *array, crc_size_t length);
   void add(const uint8_t *array, crc_size_t length, crc_size_t yieldPeriod);
 
-  void setPolynome(uint16_t polynome) { _polynome = polynome; }
+  void setPolynome(uint16_t polynome) { _polynome = polynome; _selectTable(); }
   void setInitial(uint16_t initial) { _initial = initial; }
   void setXorOut(uint16_t xorOut) { _xorOut = xorOut; }
-  void setReverseIn(bool reverseIn) { _reverseIn = reverseIn; }
+  void setReverseIn(bool reverseIn) { _reverseIn = reverseIn; _selectTable(); }
   void setReverseOut(bool reverseOut) { _reverseOut = reverseOut; }
 
   uint16_t getPolynome() const { return _polynome; }
@@ -60,6 +60,10 @@ public:
 
 private:
   void _add(uint8_t value);
+  void _selectTable();
+
+  //  Table driven update of Crc.h, set when the polynome is one of the presets
+  uint16_t (*_update)(uint16_t crc, const uint8_t *array, size_t length);
 
   uint16_t _polynome;
   uint16_t _initial;
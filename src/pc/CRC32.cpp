@@ -6,6 +6,7 @@
 
 
 #include "CRC32.h"
+#include "Crc.h"
 #include "CrcFastReverse.h"
 
 
@@ -21,7 +22,9 @@ CRC32::CRC32(uint32_t polynome,
   _reverseOut(reverseOut),
   _crc(initial),
   _count(0u)
-{}
+{
+  _selectTable();
+}
 
 void CRC32::reset(uint32_t polynome,
                   uint32_t initial,
@@ -34,6 +37,7 @@ void CRC32::reset(uint32_t polynome,
   _xorOut = xorOut;
   _reverseIn = reverseIn;
   _reverseOut = reverseOut;
+  _selectTable();
   restart();
 }
 
@@ -59,12 +63,18 @@ crc_size_t CRC32::count() const
 void CRC32::add(uint8_t value)
 {
   _count++;
-  _add(value);
+  if (_update) _crc = _update(_crc, &value, 1);
+  else _add(value);
 }
 
 void CRC32::add(const uint8_t *array, crc_size_t length)
 {
   _count += length;
+  if (_update)
+  {
+    _crc = _update(_crc, array, length);
+    return;
+  }
   while (length--)
   {
     _add(*array++);
@@ -74,6 +84,18 @@ void CRC32::add(const uint8_t *array, crc_size_t length)
 void CRC32::add(const uint8_t *array, crc_size_t length, crc_size_t yieldPeriod)
 {
   _count += length;
+  if (_update)
+  {
+    while (length)
+    {
+      crc_size_t chunk = (length < yieldPeriod) ? length : yieldPeriod;
+      _crc = _update(_crc, array, chunk);
+      array += chunk;
+      length -= chunk;
+      if (chunk == yieldPeriod) yield();
+    }
+    return;
+  }
   crc_size_t period = yieldPeriod;
   while (length--)
   {
@@ -104,6 +126,96 @@ void CRC32::_add(uint8_t value)
   }
 }
 
+//  Only the polynome and input reflection determine the table,
+//  initial value, xorOut and output reflection stay with this class.
+template <uint32_t polynome>
+static auto tableUpdate(bool reverseIn)
+{
+  return reverseIn ? &Crc<32, polynome, 0, 0, true, true>::updateUnreflected
+                   : &Crc<32, polynome, 0, 0, false, false>::updateUnreflected;
+}
+
+void CRC32::_selectTable()
+{
+  switch (_polynome)
+  {
+    case 0x04C11DB7: _update = tableUpdate<0x04C11DB7>(_reverseIn); break;
+    case 0x1EDC6F41: _update = tableUpdate<0x1EDC6F41>(_reverseIn); break;
+    case 0xA833982B: _update = tableUpdate<0xA833982B>(_reverseIn); break;
+    case 0x814141AB: _update = tableUpdate<0x814141AB>(_reverseIn); break;
+    case 0x741B8CD7: _update = tableUpdate<0x741B8CD7>(_reverseIn); break;
+    case 0x32583499: _update = tableUpdate<0x32583499>(_reverseIn); break;
+    default: _update = nullptr; break;
+  }
+}
+
+//  GF(2) matrix of 32 columns times vector
+static uint32_t gf2Times(const uint32_t *matrix, uint32_t vector)
+{
+  uint32_t sum = 0;
+  for (; vector; vector >>= 1, matrix++)
+  {
+    if (vector & 1) sum ^= *matrix;
+  }
+  return sum;
+}
+
+static void gf2Square(uint32_t *square, const uint32_t *matrix)
+{
+  for (int n = 0; n < 32; n++)
+  {
+    square[n] = gf2Times(matrix, matrix[n]);
+  }
+}
+
+//  With register in() of a CRC and the operator Z^n that feeds n zero bytes:
+//    crc(A|B) = out(Z^n(in(crc1) ^ initial) ^ in(crc2))
+//  Z^n is built by repeated squaring, as in zlib's crc32_combine().
+uint32_t CRC32::combine(uint32_t crc1, uint32_t crc2, uint64_t length2) const
+{
+  uint32_t odd[32];
+  uint32_t even[32];
+
+  if (length2 == 0) return crc1;
+
+  //  back to the registers, as kept by this class
+  crc1 ^= _xorOut;
+  crc2 ^= _xorOut;
+  if (_reverseOut)
+  {
+    crc1 = reverse32bits(crc1);
+    crc2 = reverse32bits(crc2);
+  }
+  uint32_t reg = crc1 ^ _initial;
+
+  //  operator for one zero bit
+  for (int n = 0; n < 31; n++) odd[n] = 1UL << (n + 1);
+  odd[31] = _polynome;
+
+  //  one zero byte
+  gf2Square(even, odd);   //  2 bits
+  gf2Square(odd, even);   //  4 bits
+  gf2Square(even, odd);   //  8 bits
+
+  //  apply length2 zero bytes, alternating between both operator buffers
+  uint32_t *op = even;
+  uint32_t *next = odd;
+  while (true)
+  {
+    if (length2 & 1) reg = gf2Times(op, reg);
+    length2 >>= 1;
+    if (length2 == 0) break;
+    gf2Square(next, op);
+    uint32_t *tmp = op;
+    op = next;
+    next = tmp;
+  }
+
+  reg ^= crc2;
+  if (_reverseOut) reg = reverse32bits(reg);
+  return reg ^ _xorOut;
+}
+
 uint32_t CRC32::getCRC() const
 {
   return calc();
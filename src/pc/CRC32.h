@@ -32,10 +32,14 @@ public:
   void add(const uint8_t *array, crc_size_t length);
   void add(const uint8_t *array, crc_size_t length, crc_size_t yieldPeriod);
 
-  void setPolynome(uint32_t polynome) { _polynome = polynome; }
+  //  CRC of the concatenation of two blocks, from the CRCs of both blocks
+  //  and the length of the second one, with the parameters of this object.
+  uint32_t combine(uint32_t crc1, uint32_t crc2, uint64_t length2) const;
+
+  void setPolynome(uint32_t polynome) { _polynome = polynome; _selectTable(); }
   void setInitial(uint32_t initial) { _initial = initial; }
   void setXorOut(uint32_t xorOut) { _xorOut = xorOut; }
-  void setReverseIn(bool reverseIn) { _reverseIn = reverseIn; }
+  void setReverseIn(bool reverseIn) { _reverseIn = reverseIn; _selectTable(); }
   void setReverseOut(bool reverseOut) { _reverseOut = reverseOut; }
 
   uint32_t getPolynome() const { return _polynome; }
@@ -61,6 +65,10 @@ public:
 
 private:
   void _add(uint8_t value);
+  void _selectTable();
+
+  //  Table driven update of Crc.h, set when the polynome is one of the presets
+  uint32_t (*_update)(uint32_t crc, const uint8_t *array, size_t length);
 
   uint32_t _polynome;
   uint32_t _initial;
@@ -0,0 +1,177 @@
+#pragma once
+//
+//    FILE: Crc.h
+// PURPOSE: Table driven CRC with compile-time parameters and tables
+//
+//  Crc<Width, Poly, Init, XorOut, RefIn, RefOut> follows the parameter model of
+//  CrcParameters.h. The 256 entry table is generated by the compiler, reflected
+//  for RefIn, so the inner loop is a single lookup per byte without branches.
+
+
+#include <array>
+#include <type_traits>
+#include "CrcParameters.h"
+#include "CrcDefines.h"
+
+
+template <int Width>
+using crc_register_t = typename std::conditional<(Width <= 8), uint8_t,
+                       typename std::conditional<(Width <= 16), uint16_t,
+                       typename std::conditional<(Width <= 32), uint32_t, uint64_t>::type>::type>::type;
+
+template <int Width>
+constexpr uint64_t crcMask()
+{
+  return (Width == 64) ? ~0ULL : ((1ULL << Width) - 1);
+}
+
+template <typename T, int Width>
+constexpr T crcReflect(T value)
+{
+  T result = 0;
+  for (int i = 0; i < Width; i++)
+  {
+    result = (result << 1) | (value & 1);
+    value >>= 1;
+  }
+  return result;
+}
+
+template <typename T, int Width, uint64_t Poly, bool Reflected>
+constexpr std::array<T, 256> crcTable()
+{
+  std::array<T, 256> table {};
+  const T poly = Reflected ? crcReflect<T, Width>((T)Poly) : (T)Poly;
+  const T top = (T)(1ULL << (Width - 1));
+
+  for (int i = 0; i < 256; i++)
+  {
+    T crc = Reflected ? (T)i : (T)((uint64_t)i << (Width - 8));
+    for (int bit = 0; bit < 8; bit++)
+    {
+      if (Reflected) crc = (crc & 1) ? (T)((crc >> 1) ^ poly) : (T)(crc >> 1);
+      else crc = (crc & top) ? (T)((crc << 1) ^ poly) : (T)(crc << 1);
+    }
+    table[i] = (T)(crc & crcMask<Width>());
+  }
+  return table;
+}
+
+
+template <int Width, uint64_t Poly, uint64_t Init, uint64_t XorOut, bool RefIn, bool RefOut>
+class Crc
+{
+  static_assert((Width >= 8) && (Width <= 64), "table driven CRC needs a width of 8 to 64 bits");
+
+public:
+  using value_type = crc_register_t<Width>;
+
+  static constexpr std::array<value_type, 256> table = crcTable<value_type, Width, Poly, RefIn>();
+
+  Crc() : _crc(start()), _count(0u) {}
+
+  void restart() { _crc = start(); _count = 0u; }
+  value_type calc() const { return finish(_crc); }
+  crc_size_t count() const { return _count; }
+  void add(uint8_t value) { _crc = update(_crc, &value, 1); _count++; }
+  void add(const uint8_t *array, crc_size_t length) { _crc = update(_crc, array, length); _count += length; }
+
+  //  Stateless interface, on the register as kept internally (reflected for RefIn)
+  static constexpr value_type start()
+  {
+    return RefIn ? crcReflect<value_type, Width>((value_type)(Init & crcMask<Width>())) : (value_type)(Init & crcMask<Width>());
+  }
+
+  static value_type update(value_type crc, const uint8_t *data, size_t length)
+  {
+    if (RefIn)
+    {
+      while (length--) crc = (value_type)((crc >> 8) ^ table[(crc ^ *data++) & 0xFF]);
+    }
+    else
+    {
+      while (length--) crc = (value_type)(((crc << 8) ^ table[((crc >> (Width - 8)) ^ *data++) & 0xFF]) & crcMask<Width>());
+    }
+    return crc;
+  }
+
+  static constexpr value_type finish(value_type crc)
+  {
+    if (RefIn != RefOut) crc = crcReflect<value_type, Width>(crc);
+    return (value_type)((crc ^ XorOut) & crcMask<Width>());
+  }
+
+  static value_type compute(const uint8_t *data, size_t length)
+  {
+    return finish(update(start(), data, length));
+  }
+
+  //  Update on an unreflected register, as CRC16/CRC32 keep it: they reverse the
+  //  input bytes instead of the register.
+  static value_type updateUnreflected(value_type crc, const uint8_t *data, size_t length)
+  {
+    if (!RefIn) return update(crc, data, length);
+    return crcReflect<value_type, Width>(update(crcReflect<value_type, Width>(crc), data, length));
+  }
+
+private:
+  value_type _crc;
+  crc_size_t _count;
+};
+
+
+//  Presets of CrcParameters.h
+#define CRC_PRESET(name, width, preset) \
+  using name = Crc<width, preset##_POLYNOME, preset##_INITIAL, preset##_XOR_OUT, preset##_REV_IN, preset##_REV_OUT>
+
+CRC_PRESET(Crc8,               8,  CRC8);
+CRC_PRESET(Crc8Saej1850,       8,  CRC8_SAEJ1850);
+CRC_PRESET(Crc8Saej1850Zero,   8,  CRC8_SAEJ1850_ZERO);
+CRC_PRESET(Crc8_8H2F,          8,  CRC8_8H2F);
+CRC_PRESET(Crc8Wcdma,          8,  CRC8_WCDMA);
+CRC_PRESET(Crc8Darc,           8,  CRC8_DARC);
+CRC_PRESET(Crc8DvbS2,          8,  CRC8_DVB_S2);
+CRC_PRESET(Crc8Ebu,            8,  CRC8_EBU);
+CRC_PRESET(Crc8Icode,          8,  CRC8_ICODE);
+CRC_PRESET(Crc8Itu,            8,  CRC8_ITU);
+CRC_PRESET(Crc8DallasMaxim,    8,  CRC8_DALLAS_MAXIM);
+CRC_PRESET(Crc8Rohc,           8,  CRC8_ROHC);
+CRC_PRESET(Crc12,              12, CRC12);
+CRC_PRESET(Crc16,              16, CRC16);
+CRC_PRESET(Crc16Ccitt,         16, CRC16_CCITT);
+CRC_PRESET(Crc16CcittFalse,    16, CRC16_CCITT_FALSE);
+CRC_PRESET(Crc16AugCcitt,      16, CRC16_AUG_CCITT);
+CRC_PRESET(Crc16Arc,           16, CRC16_ARC);
+CRC_PRESET(Crc16Buypass,       16, CRC16_BUYPASS);
+CRC_PRESET(Crc16Cdma2000,      16, CRC16_CDMA2000);
+CRC_PRESET(Crc16Dds110,        16, CRC16_DDS_110);
+CRC_PRESET(Crc16DectR,         16, CRC16_DECT_R);
+CRC_PRESET(Crc16DectX,         16, CRC16_DECT_X);
+CRC_PRESET(Crc16Dnp,           16, CRC16_DNP);
+CRC_PRESET(Crc16Genibus,       16, CRC16_GENIBUS);
+CRC_PRESET(Crc16Maxim,         16, CRC16_MAXIM);
+CRC_PRESET(Crc16Mcrf4xx,       16, CRC16_MCRF4XX);
+CRC_PRESET(Crc16Riello,        16, CRC16_RIELLO);
+CRC_PRESET(Crc16T10Dif,        16, CRC16_T10_DIF);
+CRC_PRESET(Crc16Teledisk,      16, CRC16_TELEDISK);
+CRC_PRESET(Crc16Tms37157,      16, CRC16_TMS37157);
+CRC_PRESET(Crc16Usb,           16, CRC16_USB);
+CRC_PRESET(Crc16A,             16, CRC16_A);
+CRC_PRESET(Crc16Kermit,        16, CRC16_KERMIT);
+CRC_PRESET(Crc16Modbus,        16, CRC16_MODBUS);
+CRC_PRESET(Crc16X25,           16, CRC16_X_25);
+CRC_PRESET(Crc16Xmodem,        16, CRC16_XMODEM);
+CRC_PRESET(Crc32,              32, CRC32);
+CRC_PRESET(Crc32Iso3309,       32, CRC32_ISO3309);
+CRC_PRESET(Crc32Castagnoli,    32, CRC32_CASTAGNOLI);
+CRC_PRESET(Crc32D,             32, CRC32_D);
+CRC_PRESET(Crc32Q,             32, CRC32_Q);
+CRC_PRESET(Crc64Ecma64,        64, CRC64_ECMA64);
+CRC_PRESET(Crc64,              64, CRC64);
+CRC_PRESET(Crc64Iso64,         64, CRC64_ISO64);
+
+#undef CRC_PRESET
+
+
+//  -- END OF FILE --
+
@@ -0,0 +1,45 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+Arena::~Arena() {
+  for(char *block : _blocks) free(block);
+}
+
+void *Arena::alloc(size_t size, size_t align) {
+  size_t pad = (align - ((uintptr_t)_next & (align - 1))) & (align - 1);
+
+  if(!_next || (pad + size > _left)) {
+    // Allocations larger than a quarter block get a block of their own, the current block stays in use
+    size_t blocksize = (size > ARENA_BLOCK_SIZE / 4) ? size : ARENA_BLOCK_SIZE;
+    char *block = (char *)malloc(blocksize);
+    if(!block) return NULL;
+    _blocks.push_back(block);
+    if(blocksize != ARENA_BLOCK_SIZE) return block;  // malloc alignment suits any type
+
+    _next = block;
+    _left = blocksize;
+    pad = 0;
+  }
+
+  char *p = _next + pad;
+  _next = p + size;
+  _left -= pad + size;
+  return p;
+}
+
+char *Arena::strdup(const char *s) {
+  return join(s, "");
+}
+
+char *Arena::join(const char *a, const char *b) {
+  size_t alength = strlen(a);
+  size_t blength = strlen(b);
+  char *p = (char *)alloc(alength + blength + 1, 1);
+
+  if(!p) return NULL;
+  memcpy(p, a, alength);
+  memcpy(p + alength, b, blength + 1);
+  return p;
+}
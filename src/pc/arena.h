@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+#define ARENA_BLOCK_SIZE               (64 * 1024)
+
+// Bump allocator for many small allocations that live as long as their owner, such as
+// the names and the file table of a session. Memory is taken from large blocks and only
+// released all at once, by the destructor; there is no per-allocation free().
+class Arena {
+  public:
+    Arena() : _next(NULL), _left(0) {}
+   ~Arena();
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void *alloc(size_t size, size_t align = alignof(max_align_t)); // NULL if out of memory
+    char *strdup(const char *s);
+    char *join(const char *a, const char *b);   // a followed by b
+
+  private:
+    std::vector<char *> _blocks;
+    char *_next;
+    size_t _left;
+};
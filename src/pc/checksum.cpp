@@ -0,0 +1,138 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "CRC32.h"
+#include "checksum.h"
+
+ParallelChecksum::ParallelChecksum(unsigned int threads)
+    : _stop(false)
+{
+  if(threads == 0) threads = std::thread::hardware_concurrency();
+  if(threads == 0) threads = 1;
+
+  for(unsigned int n = 0; n < threads; n++) _threads.emplace_back(&ParallelChecksum::run, this);
+}
+
+ParallelChecksum::~ParallelChecksum() {
+  {
+    std::lock_guard<std::mutex> guard(_lock);
+    _stop = true;
+  }
+  _work.notify_all();
+  for(std::thread &t : _threads) t.join();
+}
+
+void ParallelChecksum::submit(std::function<void(void)> task) {
+  {
+    std::lock_guard<std::mutex> guard(_lock);
+    _tasks.push_back(std::move(task));
+  }
+  _work.notify_one();
+}
+
+void ParallelChecksum::run(void) {
+  std::unique_lock<std::mutex> guard(_lock);
+
+  while(1) {
+    _work.wait(guard, [this] { return _stop || !_tasks.empty(); });
+    if(_tasks.empty()) return; // stopped, queue drained
+
+    std::function<void(void)> task = std::move(_tasks.front());
+    _tasks.pop_front();
+    guard.unlock();
+    task();
+    guard.lock();
+  }
+}
+
+// Counts outstanding chunks of one call, which waits until all are done
+class ChunkLatch {
+  public:
+    void add(void) { std::lock_guard<std::mutex> guard(_lock); _pending++; }
+    void done(void) {
+      std::lock_guard<std::mutex> guard(_lock);
+      if(--_pending == 0) _zero.notify_all();
+    }
+    void wait(void) {
+      std::unique_lock<std::mutex> guard(_lock);
+      _zero.wait(guard, [this] { return _pending == 0; });
+    }
+
+  private:
+    size_t _pending = 0;
+    std::mutex _lock;
+    std::condition_variable _zero;
+};
+
+void ParallelChecksum::files(checksum_file_t *list, size_t count) {
+  std::vector<int> fds(count, -1);
+  std::vector<std::vector<uint32_t>> results(count);
+  std::vector<std::vector<char>> failed(count);  // each chunk writes only its own entries
+  ChunkLatch latch;
+  CRC32 crc;
+
+  for(size_t i = 0; i < count; i++) {
+    struct stat st;
+
+    list[i].ok = false;
+    list[i].size = 0;
+    list[i].crc = 0;
+    fds[i] = open(list[i].path, O_RDONLY);
+    if(fds[i] < 0) continue;
+    if((fstat(fds[i], &st) != 0) || !S_ISREG(st.st_mode)) {
+      close(fds[i]);
+      fds[i] = -1;
+      continue;
+    }
+    list[i].size = st.st_size;
+
+    size_t chunks = (st.st_size + CHECKSUM_CHUNK_SIZE - 1) / CHECKSUM_CHUNK_SIZE;
+    results[i].resize(chunks);
+    failed[i].resize(chunks, 0);
+    for(size_t n = 0; n < chunks; n++) {
+      uint64_t offset = (uint64_t)n * CHECKSUM_CHUNK_SIZE;
+      uint64_t length = ((uint64_t)st.st_size - offset < CHECKSUM_CHUNK_SIZE) ? st.st_size - offset : CHECKSUM_CHUNK_SIZE;
+      int fd = fds[i];
+
+      latch.add();
+      submit([&results, &failed, &latch, i, n, fd, offset, length] {
+        std::vector<uint8_t> buffer(CHECKSUM_READ_SIZE);
+        CRC32 chunk;
+        uint64_t done = 0;
+
+        while(done < length) {
+          size_t want = (length - done < CHECKSUM_READ_SIZE) ? length - done : CHECKSUM_READ_SIZE;
+          ssize_t got = pread(fd, buffer.data(), want, offset + done);
+          if(got <= 0) {
+            failed[i][n] = 1;
+            break;
+          }
+          chunk.add(buffer.data(), got);
+          done += got;
+        }
+        results[i][n] = chunk.calc();
+        latch.done();
+      });
+    }
+  }
+  latch.wait();
+
+  for(size_t i = 0; i < count; i++) {
+    if(fds[i] < 0) continue;
+    close(fds[i]);
+
+    bool ok = true;
+    for(char f : failed[i]) ok = ok && !f;
+    if(!ok) continue;
+
+    uint32_t result = crc.calc(); // empty file
+    uint64_t offset = 0;
+    for(size_t n = 0; n < results[i].size(); n++) {
+      uint64_t length = (list[i].size - offset < CHECKSUM_CHUNK_SIZE) ? list[i].size - offset : CHECKSUM_CHUNK_SIZE;
+      result = (n == 0) ? results[i][0] : crc.combine(result, results[i][n], length);
+      offset += length;
+    }
+    list[i].crc = result;
+    list[i].ok = true;
+  }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define CHECKSUM_CHUNK_SIZE            (4 * 1024 * 1024)   // unit of work on the pool threads
+#define CHECKSUM_READ_SIZE             (256 * 1024)
+
+typedef struct {
+  const char *path;
+  uint64_t size;
+  uint32_t crc;      // standard CRC32, as CRC32 with its default parameters
+  bool ok;           // false if the file couldn't be opened or read
+} checksum_file_t;
+
+// Computes CRC32s of files on a pool of threads. Files are split into chunks;
+// chunks are checksummed in parallel and merged with CRC32::combine().
+class ParallelChecksum {
+  public:
+    ParallelChecksum(unsigned int threads = 0); // 0: one thread per core
+   ~ParallelChecksum();
+
+    void files(checksum_file_t *list, size_t count); // all chunks of all files are queued at once
+
+  private:
+    void run(void);
+    void submit(std::function<void(void)> task);
+
+    std::vector<std::thread> _threads;
+    std::deque<std::function<void(void)>> _tasks;
+    bool _stop;
+    std::mutex _lock;
+    std::condition_variable _work;
+};
@@ -0,0 +1,434 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "diskwriter.h"
+
+DiskWriter::DiskWriter(bool atomic)
+    : _head(0),
+      _tail(0),
+      _producer_waiting(false),
+      _consumer_waiting(false),
+      _failed(false),
+      _stop(false),
+      _atomic(atomic),
+      _fd(-1),
+      _filename(NULL),
+      _tempname(NULL),
+      _sequence(0)
+{
+  _error[0] = 0;
+  _thread = std::thread(&DiskWriter::run, this);
+}
+
+DiskWriter::~DiskWriter() {
+  flush();
+  {
+    std::lock_guard<std::mutex> guard(_lock);
+    _stop = true;
+  }
+  _work.notify_one();
+  _thread.join();
+}
+
+// Returns the next free slot, waits for the writer thread if the ring is full
+diskwriter_slot_t *DiskWriter::acquire(void) {
+  size_t head = _head.load(std::memory_order_relaxed);
+
+  if((head - _tail.load(std::memory_order_acquire)) == DISKWRITER_SLOTS) {
+    std::unique_lock<std::mutex> guard(_lock);
+    _producer_waiting = true;
+    _space.wait(guard, [this, head] { return (head - _tail.load()) < DISKWRITER_SLOTS; });
+    _producer_waiting = false;
+  }
+  return &_slots[head % DISKWRITER_SLOTS];
+}
+
+// Hands the acquired slot to the writer thread
+void DiskWriter::publish(void) {
+  _head.store(_head.load(std::memory_order_relaxed) + 1);
+  if(_consumer_waiting) {
+    std::lock_guard<std::mutex> guard(_lock);
+    _work.notify_one();
+  }
+}
+
+bool DiskWriter::open(const char *filename, size_t filesize) {
+  diskwriter_slot_t *slot = acquire();
+
+  slot->op = DISKWRITER_OPEN;
+  slot->length = filesize;
+  slot->filename = strdup(filename);
+  if(slot->filename == NULL) return false;
+  publish();
+  return true;
+}
+
+bool DiskWriter::write(const uint8_t *data, size_t length) {
+  while(length) {
+    diskwriter_slot_t *slot = acquire();
+    size_t chunk = (length > DISKWRITER_SLOT_SIZE) ? DISKWRITER_SLOT_SIZE : length;
+
+    slot->op = DISKWRITER_DATA;
+    slot->length = chunk;
+    memcpy(slot->data, data, chunk);
+    publish();
+    data += chunk;
+    length -= chunk;
+  }
+  return !failed();
+}
+
+bool DiskWriter::close(void) {
+  diskwriter_slot_t *slot = acquire();
+
+  slot->op = DISKWRITER_CLOSE;
+  publish();
+  return !failed();
+}
+
+bool DiskWriter::discard(void) {
+  diskwriter_slot_t *slot = acquire();
+
+  slot->op = DISKWRITER_DISCARD;
+  publish();
+  return !failed();
+}
+
+bool DiskWriter::commit(void) {
+  diskwriter_slot_t *slot = acquire();
+
+  slot->op = DISKWRITER_COMMIT;
+  publish();
+  return !failed();
+}
+
+bool DiskWriter::rollback(void) {
+  diskwriter_slot_t *slot = acquire();
+
+  slot->op = DISKWRITER_ROLLBACK;
+  publish();
+  return !failed();
+}
+
+bool DiskWriter::flush(void) {
+  size_t head = _head.load(std::memory_order_relaxed);
+
+  if(_tail.load(std::memory_order_acquire) != head) {
+    std::unique_lock<std::mutex> guard(_lock);
+    _producer_waiting = true;
+    _space.wait(guard, [this, head] { return _tail.load() == head; });
+    _producer_waiting = false;
+  }
+  return !failed();
+}
+
+bool DiskWriter::failed(void) {
+  return _failed.load(std::memory_order_acquire);
+}
+
+const char *DiskWriter::error(void) {
+  return _error;
+}
+
+void DiskWriter::fail(const char *message, const char *filename) {
+  if(!_failed.load(std::memory_order_relaxed)) {
+    snprintf(_error, sizeof(_error), "%s \'%s\': %s", message, filename ? filename : "", strerror(errno));
+    _failed.store(true, std::memory_order_release);
+  }
+  if(_fd >= 0) ::close(_fd);
+  _fd = -1;
+  if(_tempname) {
+    unlink(_tempname);
+    free(_tempname);
+    _tempname = NULL;
+  }
+}
+
+// Creates all missing directories leading up to a file path. In atomic mode the directory
+// each new one was made in is remembered, so the commit makes the new entry durable too.
+bool DiskWriter::make_parent_dirs(const char *filename) {
+  char path[PATH_MAX];
+
+  if(strlen(filename) >= PATH_MAX) return false;
+  strcpy(path, filename);
+
+  for(char *p = path + 1; *p; p++) {
+    if(*p != '/') continue;
+    *p = 0;
+    if(mkdir(path, 0777) == 0) {
+      if(_atomic) {
+        const char *base = strrchr(path, '/');
+        _created.push_back(base ? std::string(path, (base == path) ? 1 : base - path) : std::string("."));
+      }
+    }
+    else if(errno != EEXIST) return false;
+    *p = '/';
+  }
+  return true;
+}
+
+// Closes and removes the file being written
+void DiskWriter::discard_file(void) {
+  if(_fd >= 0) ::close(_fd);
+  _fd = -1;
+  if(_atomic) {
+    if(_tempname) unlink(_tempname);
+    free(_tempname);
+    _tempname = NULL;
+  }
+  else if(_filename) unlink(_filename);
+}
+
+// Creates a unique temporary file next to _filename, the previous one is closed or discarded.
+// It is created with open() rather than mkstemp(), so the umask sets its mode like for any new file.
+bool DiskWriter::open_temporary(void) {
+  const char *base = strrchr(_filename, '/');
+  size_t dirlength = base ? (size_t)(base - _filename + 1) : 0;
+  size_t length = dirlength + sizeof(".ymodem-4294967295-4294967295");
+
+  _tempname = (char *)malloc(length);
+  if(_tempname == NULL) return false;
+  memcpy(_tempname, _filename, dirlength);
+
+  for(int attempt = 0; attempt < DISKWRITER_TEMP_ATTEMPTS; attempt++) {
+    snprintf(_tempname + dirlength, length - dirlength, ".ymodem-%u-%u", (unsigned)getpid(), _sequence++);
+    _fd = ::open(_tempname, O_WRONLY | O_CREAT | O_EXCL, 0666);
+    if((_fd >= 0) || (errno != EEXIST)) break;
+  }
+  if(_fd < 0) {
+    free(_tempname);
+    _tempname = NULL;
+    return false;
+  }
+  return true;
+}
+
+// Renames a pending file to its final name. A file already there stays linked under a
+// backup name, or is moved there where hard links aren't supported. A directory is never replaced.
+bool DiskWriter::replace(diskwriter_pending_t &p) {
+  struct stat st;
+
+  if(lstat(p.filename, &st) == 0) {
+    if(!S_ISDIR(st.st_mode)) {
+      p.backup = (char *)malloc(strlen(p.tempname) + 2);
+      if(p.backup == NULL) return false;
+      sprintf(p.backup, "%s~", p.tempname);
+      if((link(p.filename, p.backup) != 0) && (rename(p.filename, p.backup) != 0)) {
+        free(p.backup);
+        p.backup = NULL;
+        return false;
+      }
+    }
+  }
+  else if(errno != ENOENT) return false;
+  return rename(p.tempname, p.filename) == 0;
+}
+
+// Undoes the renames of the pending files before 'failed' and the backup of 'failed' itself
+void DiskWriter::restore_pending(size_t failed) {
+  struct stat st;
+
+  for(size_t n = failed + 1; n-- > 0;) {
+    diskwriter_pending_t &p = _pending[n];
+    if(n < failed) {
+      if(p.backup) rename(p.backup, p.filename);
+      else unlink(p.filename);
+    }
+    else if(p.backup) {
+      if(lstat(p.filename, &st) == 0) unlink(p.backup);  // still in place, next to its link
+      else rename(p.backup, p.filename);
+    }
+    free(p.backup);
+    p.backup = NULL;
+  }
+}
+
+// Group commit of all pending files: one sync per filesystem, the renames,
+// then one fsync per target directory to make the new names durable.
+// Directories created for the batch are made durable in their parents as well.
+void DiskWriter::commit_pending(void) {
+  std::vector<std::string> dirs;
+
+  for(diskwriter_pending_t &p : _pending) {
+    const char *base = strrchr(p.filename, '/');
+    dirs.push_back(base ? std::string(p.filename, base - p.filename) : std::string("."));
+  }
+  dirs.insert(dirs.end(), _created.begin(), _created.end());
+  _created.clear();
+  std::sort(dirs.begin(), dirs.end());
+  dirs.erase(std::unique(dirs.begin(), dirs.end()), dirs.end());
+
+#ifdef __linux__
+  std::vector<dev_t> devices;
+  for(std::string &d : dirs) {
+    struct stat st;
+    if(stat(d.c_str(), &st) != 0) { fail("Error syncing", d.c_str()); remove_pending(); return; }
+    if(std::find(devices.begin(), devices.end(), st.st_dev) != devices.end()) continue;
+    devices.push_back(st.st_dev);
+
+    int fd = ::open(d.c_str(), O_RDONLY | O_DIRECTORY);
+    if((fd < 0) || (syncfs(fd) != 0)) {
+      if(fd >= 0) ::close(fd);
+      fail("Error syncing", d.c_str());
+      remove_pending();
+      return;
+    }
+    ::close(fd);
+  }
+#else
+  for(diskwriter_pending_t &p : _pending) {
+    int fd = ::open(p.tempname, O_RDONLY);
+    if((fd < 0) || (fsync(fd) != 0)) {
+      if(fd >= 0) ::close(fd);
+      fail("Error syncing", p.filename);
+      remove_pending();
+      return;
+    }
+    ::close(fd);
+  }
+#endif
+
+  for(size_t n = 0; n < _pending.size(); n++) {
+    if(!replace(_pending[n])) {
+      fail("Error renaming to", _pending[n].filename);
+      restore_pending(n);
+      remove_pending();
+      return;
+    }
+  }
+  for(diskwriter_pending_t &p : _pending) {
+    if(p.backup) unlink(p.backup);
+    free(p.backup);
+    free(p.tempname);
+    free(p.filename);
+  }
+  _pending.clear();
+
+  for(std::string &d : dirs) {
+    int fd = ::open(d.c_str(), O_RDONLY);
+    if((fd < 0) || (fsync(fd) != 0)) fail("Error syncing", d.c_str());
+    if(fd >= 0) ::close(fd);
+  }
+}
+
+void DiskWriter::remove_pending(void) {
+  for(diskwriter_pending_t &p : _pending) {
+    unlink(p.tempname);
+    free(p.tempname);
+    free(p.filename);
+  }
+  _pending.clear();
+  _created.clear();
+}
+
+// Handles a batch of slots. Consecutive data slots are written with a single writev.
+void DiskWriter::process(diskwriter_slot_t *slots[], size_t count) {
+  struct iovec iov[DISKWRITER_SLOTS];
+
+  for(size_t n = 0; n < count; n++) {
+    diskwriter_slot_t *slot = slots[n];
+
+    switch(slot->op) {
+      case DISKWRITER_OPEN:
+        // A file still open was never closed, it is incomplete
+        if((_fd >= 0) || _tempname) discard_file();
+        free(_filename);
+        _filename = slot->filename;
+        if(!make_parent_dirs(_filename)) { fail("Error creating directory for", _filename); break; }
+        if(_atomic) {
+          if(!open_temporary()) { fail("Error creating temporary file for", _filename); break; }
+        }
+        else _fd = ::open(_filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if(_fd < 0) { fail("Error opening", _filename); break; }
+#ifdef __linux__
+        // Allocate the whole file up front, not supported by every filesystem
+        if(slot->length && (fallocate(_fd, 0, 0, slot->length) != 0) && (errno != EOPNOTSUPP)) fail("Error allocating", _filename);
+#endif
+        break;
+      case DISKWRITER_DATA: {
+        size_t iovcnt = 0;
+        size_t total = 0;
+        while((n + iovcnt < count) && (slots[n + iovcnt]->op == DISKWRITER_DATA)) {
+          iov[iovcnt].iov_base = slots[n + iovcnt]->data;
+          iov[iovcnt].iov_len = slots[n + iovcnt]->length;
+          total += slots[n + iovcnt]->length;
+          iovcnt++;
+        }
+        n += iovcnt - 1;
+        if(_fd < 0) break;
+        ssize_t written = writev(_fd, iov, (int)iovcnt);
+        if((written < 0) || ((size_t)written != total)) fail("Error writing to", _filename);
+        break;
+      }
+      case DISKWRITER_CLOSE:
+        if(_fd < 0) break;
+        if(_atomic) {
+#ifdef __linux__
+          // Start writeback now, the commit only has to wait for it
+          sync_file_range(_fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+#endif
+          if(::close(_fd) != 0) { _fd = -1; fail("Error closing", _filename); break; }
+          _fd = -1;
+          _pending.push_back({_tempname, _filename, NULL});
+          _tempname = NULL;
+          _filename = NULL;
+          break;
+        }
+        if(fsync(_fd) != 0) { fail("Error syncing", _filename); break; }
+        if(::close(_fd) != 0) { _fd = -1; fail("Error closing", _filename); }
+        _fd = -1;
+        break;
+      case DISKWRITER_DISCARD:
+        discard_file();
+        break;
+      case DISKWRITER_COMMIT:
+        if(_failed.load(std::memory_order_relaxed)) remove_pending();
+        else commit_pending();
+        break;
+      case DISKWRITER_ROLLBACK:
+        remove_pending();
+        break;
+    }
+  }
+}
+
+void DiskWriter::run(void) {
+  diskwriter_slot_t *batch[DISKWRITER_SLOTS];
+
+  while(1) {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    size_t head = _head.load();
+
+    if(head == tail) {
+      std::unique_lock<std::mutex> guard(_lock);
+      _consumer_waiting = true;
+      _work.wait(guard, [this, tail] { return (_head.load() != tail) || _stop; });
+      _consumer_waiting = false;
+      if(_stop && (_head.load() == tail)) break;
+      continue;
+    }
+
+    size_t count = head - tail;
+    for(size_t n = 0; n < count; n++) batch[n] = &_slots[(tail + n) % DISKWRITER_SLOTS];
+    process(batch, count);
+
+    _tail.store(head);
+    if(_producer_waiting) {
+      std::lock_guard<std::mutex> guard(_lock);
+      _space.notify_one();
+    }
+  }
+  if(_fd >= 0) ::close(_fd);
+  if(_tempname) unlink(_tempname);
+  remove_pending();
+  free(_tempname);
+  free(_filename);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <vector>
+
+#define DISKWRITER_SLOTS               64
+#define DISKWRITER_SLOT_SIZE           1024
+#define DISKWRITER_ERROR_LENGTH        256
+#define DISKWRITER_TEMP_ATTEMPTS       100   // temporary names tried before giving up
+
+typedef enum {
+  DISKWRITER_OPEN,      // create a file, preallocated to 'length' bytes
+  DISKWRITER_DATA,      // append 'length' bytes to the open file
+  DISKWRITER_CLOSE,     // file complete, fsync and close it (atomic mode: close, sync at commit)
+  DISKWRITER_DISCARD,   // file incomplete, close and remove it
+  DISKWRITER_COMMIT,    // batch complete, publish all pending files
+  DISKWRITER_ROLLBACK   // batch failed, remove all pending files
+} diskwriter_op_t;
+
+typedef struct {
+  diskwriter_op_t op;
+  size_t length;
+  char *filename;
+  uint8_t data[DISKWRITER_SLOT_SIZE];
+} diskwriter_slot_t;
+
+typedef struct {
+  char *tempname;
+  char *filename;
+  char *backup;         // the file 'filename' replaced, kept until the whole batch is published
+} diskwriter_pending_t;
+
+// Writes received files on a dedicated thread, so disk latency never delays an ACK.
+// All calls except the constructor/destructor must come from a single producer thread;
+// slots are handed over through a bounded single-producer/single-consumer ring.
+//
+// In atomic mode files are written to a temporary name in their target directory and
+// only renamed to their final name by commit(). The batch is synced once per filesystem
+// and each target directory once, instead of fsyncing every single file. Files that are
+// replaced are kept aside until all renames are done, so a failing rename puts them back.
+class DiskWriter {
+  public:
+    DiskWriter(bool atomic = false);
+   ~DiskWriter();
+
+    bool open(const char *filename, size_t filesize);
+    bool write(const uint8_t *data, size_t length);
+    bool close(void);
+    bool discard(void);
+    bool commit(void);
+    bool rollback(void);
+    bool flush(void);   // waits until all queued work is on disk, false if anything failed
+    bool failed(void);  // non-blocking check for an earlier failure
+    const char *error(void);
+
+  private:
+    diskwriter_slot_t *acquire(void);
+    void publish(void);
+    void run(void);
+    void process(diskwriter_slot_t *slots[], size_t count);
+    void fail(const char *message, const char *filename);
+    void discard_file(void);
+    bool open_temporary(void);
+    bool make_parent_dirs(const char *filename);
+    bool replace(diskwriter_pending_t &p);
+    void restore_pending(size_t failed);
+    void commit_pending(void);
+    void remove_pending(void);
+
+    diskwriter_slot_t _slots[DISKWRITER_SLOTS];
+    std::atomic<size_t> _head;      // next slot the producer fills
+    std::atomic<size_t> _tail;      // next slot the writer processes
+    std::atomic<bool> _producer_waiting;
+    std::atomic<bool> _consumer_waiting;
+    std::atomic<bool> _failed;
+    bool _stop;
+    std::mutex _lock;
+    std::condition_variable _space;
+    std::condition_variable _work;
+
+    // Writer thread state
+    bool _atomic;
+    int _fd;
+    char *_filename;
+    char *_tempname;
+    unsigned _sequence; // of temporary names; the open fails on a name already taken
+    std::vector<diskwriter_pending_t> _pending;
+    std::vector<std::string> _created;  // parents of directories created for pending files
+    char _error[DISKWRITER_ERROR_LENGTH];
+    std::thread _thread;
+};
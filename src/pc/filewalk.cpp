@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "filewalk.h"
+
+FileWalker::FileWalker(int count, char **paths, bool recursive, const char *root)
+    : _count(count),
+      _paths(paths),
+      _recursive(recursive),
+      _root(root),
+      _head(0),
+      _tail(0),
+      _done(false),
+      _failed(false),
+      _stop(false)
+{
+  _thread = std::thread(&FileWalker::run, this);
+}
+
+FileWalker::~FileWalker() {
+  {
+    std::lock_guard<std::mutex> guard(_lock);
+    _stop = true;
+  }
+  _changed.notify_all();
+  _thread.join();
+}
+
+bool FileWalker::next(filewalk_entry_t *entry) {
+  std::unique_lock<std::mutex> guard(_lock);
+
+  _changed.wait(guard, [this] { return (_head != _tail) || _done; });
+  if(_head == _tail) return false; // walk done, queue drained
+
+  *entry = _queue[_tail % FILEWALK_QUEUE_LENGTH];
+  _tail++;
+  guard.unlock();
+  _changed.notify_all();
+  return true;
+}
+
+bool FileWalker::failed(void) {
+  std::lock_guard<std::mutex> guard(_lock);
+  return _failed;
+}
+
+bool FileWalker::push(const char *path, const char *name) {
+  std::unique_lock<std::mutex> guard(_lock);
+
+  if(strlen(name) > FILEWALK_MAX_NAME_LENGTH) {
+    printf("\nName too long \'%s\'\n", name);
+    return false;
+  }
+  _changed.wait(guard, [this] { return ((_head - _tail) < FILEWALK_QUEUE_LENGTH) || _stop; });
+  if(_stop) return false;
+
+  filewalk_entry_t &e = _queue[_head % FILEWALK_QUEUE_LENGTH];
+  strcpy(e.path, path);
+  strcpy(e.name, name);
+  _head++;
+  guard.unlock();
+  _changed.notify_all();
+  return true;
+}
+
+// Depth-first walk below 'path'. Names are sent relative to 'rootlen'.
+bool FileWalker::walk(char *path, size_t pathlen, size_t rootlen, int depth) {
+  struct dirent *de;
+  struct stat st;
+
+  if(depth >= FILEWALK_MAX_DEPTH) {
+    printf("\nDirectory depth exceeded at \'%s\'\n", path);
+    return false;
+  }
+
+  DIR *d = opendir(path);
+  if(!d) { printf("\nError opening directory \'%s\'\n", path); return false; }
+
+  while((de = readdir(d)) != NULL) {
+    if((strcmp(de->d_name, ".") == 0) || (strcmp(de->d_name, "..") == 0)) continue;
+
+    size_t len = pathlen + 1 + strlen(de->d_name);
+    if(len >= PATH_MAX) { printf("\nPath too long in \'%s\'\n", path); closedir(d); return false; }
+    path[pathlen] = '/';
+    strcpy(path + pathlen + 1, de->d_name);
+
+    bool ok = true;
+    if(stat(path, &st) == 0) {
+      if(S_ISDIR(st.st_mode)) ok = walk(path, len, rootlen, depth + 1);
+      else if(S_ISREG(st.st_mode)) ok = push(path, path + rootlen);
+    }
+    path[pathlen] = 0;
+    if(!ok) { closedir(d); return false; }
+  }
+  closedir(d);
+  return true;
+}
+
+void FileWalker::run(void) {
+  char path[PATH_MAX];
+  struct stat st;
+  bool ok = true;
+
+  for(int n = 0; (n < _count) && ok; n++) {
+    size_t prefix = _root ? strlen(_root) + 1 : 0;
+    int written = _root ? snprintf(path, sizeof(path), "%s/%s", _root, _paths[n]) : snprintf(path, sizeof(path), "%s", _paths[n]);
+    if((written < 0) || (written >= (int)sizeof(path))) { printf("\nPath too long \'%s\'\n", _paths[n]); ok = false; break; }
+    size_t len = written;
+    while((len > 1) && (path[len-1] == '/')) path[--len] = 0;
+
+    // Files are sent by their basename, directories keep their own name as top-level directory.
+    // Below a root, the relative path is kept as it is.
+    const char *base = strrchr(path, '/');
+    size_t rootlen = _root ? prefix : (base ? (size_t)(base - path + 1) : 0);
+
+    if(stat(path, &st) != 0) { printf("\nError opening \'%s\'\n", path); ok = false; break; }
+    if(S_ISDIR(st.st_mode)) {
+      if(!_recursive) { printf("\n\'%s\' is a directory, use -R\n", path); ok = false; break; }
+      // '.' and '..' have no name of their own, send their contents relative to them
+      if((strcmp(path + rootlen, ".") == 0) || (strcmp(path + rootlen, "..") == 0) || (strcmp(path, "/") == 0)) rootlen = len + 1;
+      ok = walk(path, len, rootlen, 0);
+    }
+    else ok = push(path, path + rootlen);
+  }
+
+  std::lock_guard<std::mutex> guard(_lock);
+  _failed = !ok && !_stop;
+  _done = true;
+  _changed.notify_all();
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stddef.h>
+#include <limits.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#define FILEWALK_QUEUE_LENGTH          64
+#define FILEWALK_MAX_DEPTH             32
+#define FILEWALK_MAX_NAME_LENGTH       100
+
+typedef struct {
+  char path[PATH_MAX];                           // local path to open
+  char name[FILEWALK_MAX_NAME_LENGTH + 1];       // name to send in block 0, relative for recursive walks
+} filewalk_entry_t;
+
+// Walks the given files and (optionally) directories on a background thread,
+// so the next files are found while earlier ones are still being transmitted.
+class FileWalker {
+  public:
+    FileWalker(int count, char **paths, bool recursive, const char *root = NULL); // root: paths are relative to it, and sent as such
+   ~FileWalker();
+
+    bool next(filewalk_entry_t *entry); // blocks until the next file is found, false at the end of the walk
+    bool failed(void);                  // true if the walk ended because of an error
+
+  private:
+    void run(void);
+    bool walk(char *path, size_t pathlen, size_t rootlen, int depth);
+    bool push(const char *path, const char *name);
+
+    int _count;
+    char **_paths;
+    bool _recursive;
+    const char *_root;
+
+    filewalk_entry_t _queue[FILEWALK_QUEUE_LENGTH];
+    size_t _head;
+    size_t _tail;
+    bool _done;
+    bool _failed;
+    bool _stop;
+    std::mutex _lock;
+    std::condition_variable _changed;
+    std::thread _thread;
+};
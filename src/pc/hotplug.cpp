@@ -0,0 +1,166 @@
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "hotplug.h"
+#include "serial.h"
+#include "serial_enum.h"
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+
+#define HOTPLUG_EVENT_SIZE             4096
+#define HOTPLUG_KERNEL_GROUP           1     // raw kernel uevents, ahead of udev rules
+#define HOTPLUG_OPEN_RETRIES           20
+#define HOTPLUG_OPEN_INTERVAL          100   // ms, udev may still be setting up the device node
+
+static std::mutex active_lock;
+static std::set<std::string> active;  // boards with a transfer running
+static std::mutex print_lock;
+
+static void report(const char *name, const char *message) {
+  std::lock_guard<std::mutex> guard(print_lock);
+  printf("%s: %s\n", name, message);
+  fflush(stdout);
+}
+
+// Uevents are "action@devpath" followed by NUL separated KEY=value pairs
+static const char *uevent_value(const char *event, size_t length, const char *key) {
+  size_t keylength = strlen(key);
+  const char *end = event + length;
+
+  for(const char *p = event; p < end; p += strlen(p) + 1) {
+    if((strncmp(p, key, keylength) == 0) && (p[keylength] == '=')) return p + keylength + 1;
+  }
+  return NULL;
+}
+
+static int open_device(const char *device, int baudrate) {
+  int fd = -1;
+
+  for(int n = 0; n < HOTPLUG_OPEN_RETRIES; n++) {
+    fd = serial_open(device, baudrate);
+    if(fd >= 0) break;
+    if((errno != EACCES) && (errno != ENOENT) && (errno != EBUSY)) break;
+    usleep(HOTPLUG_OPEN_INTERVAL * 1000);
+  }
+  return fd;
+}
+
+static void serve(std::string name, int filecount, char **filenames, ymodem_options_t options, bool low_latency) {
+  std::string device = "/dev/" + name;
+  std::string stats;
+
+  int fd = open_device(device.c_str(), options.baudrate);
+  if(fd < 0) {
+    report(name.c_str(), strerror(errno));
+  }
+  else {
+    if(low_latency) serial_low_latency(fd, device.c_str(), false);
+    if(options.stats_path) {
+      stats = std::string(options.stats_path) + "." + name;  // one file per board
+      options.stats_path = stats.c_str();
+    }
+
+    report(name.c_str(), "sending");
+    ymodem_transfer_t *transfer = ymodem_transfer_open(fd, &options);
+    if(!transfer) report(name.c_str(), "out of memory");
+    else {
+      bool ok = ymodem_transfer_send(transfer, filecount, filenames);
+      report(name.c_str(), ok ? "done" : ymodem_transfer_error(transfer));
+      ymodem_transfer_close(transfer);
+    }
+    serial_close(fd);
+  }
+
+  std::lock_guard<std::mutex> guard(active_lock);
+  active.erase(name);
+}
+
+static void added(const char *name, int filecount, char **filenames, const ymodem_options_t *options, bool low_latency) {
+  char vid[8], pid[8];
+
+  if(!serial_linux_usb_ids(name, vid, pid, NULL, 0)) return;
+  if(!serial_find_profile(vid, pid)) return;
+
+  {
+    std::lock_guard<std::mutex> guard(active_lock);
+    if(!active.insert(name).second) return;  // still busy with this board
+  }
+  std::thread(serve, std::string(name), filecount, filenames, *options, low_latency).detach();
+}
+
+extern "C" bool hotplug_send(int filecount, char **filenames, const ymodem_options_t *options, bool low_latency) {
+  struct sockaddr_nl address;
+  char event[HOTPLUG_EVENT_SIZE + 1];
+  ymodem_options_t board = *options;
+
+  int sock = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+  if(sock < 0) {
+    printf("Error %i from netlink socket: %s\n", errno, strerror(errno));
+    return false;
+  }
+  memset(&address, 0, sizeof(address));
+  address.nl_family = AF_NETLINK;
+  address.nl_groups = HOTPLUG_KERNEL_GROUP;
+  if(bind(sock, (struct sockaddr *)&address, sizeof(address)) < 0) {
+    printf("Error %i from netlink bind: %s\n", errno, strerror(errno));
+    close(sock);
+    return false;
+  }
+
+  board.quiet = true;  // progress bars of several boards would garble each other
+  printf("Waiting for boards, Ctrl-C to stop\n");
+  fflush(stdout);
+
+  while(1) {
+    struct sockaddr_nl sender;
+    struct iovec iov = {event, HOTPLUG_EVENT_SIZE};
+    struct msghdr msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &sender;
+    msg.msg_namelen = sizeof(sender);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    ssize_t length = recvmsg(sock, &msg, 0);
+    if(length < 0) {
+      if((errno == EINTR) || (errno == ENOBUFS)) continue;  // ENOBUFS: events were dropped, keep going
+      printf("Error %i from netlink: %s\n", errno, strerror(errno));
+      break;
+    }
+    if(sender.nl_pid != 0) continue;  // only the kernel sends uevents on this group
+    event[length] = 0;
+
+    const char *action = uevent_value(event, length, "ACTION");
+    const char *subsystem = uevent_value(event, length, "SUBSYSTEM");
+    const char *name = uevent_value(event, length, "DEVNAME");
+    if(!action || !subsystem || !name) continue;
+    if((strcmp(action, "add") != 0) || (strcmp(subsystem, "tty") != 0)) continue;
+
+    added(name, filecount, filenames, &board, low_latency);
+  }
+  close(sock);
+  return false;
+}
+
+#else
+
+extern "C" bool hotplug_send(int filecount, char **filenames, const ymodem_options_t *options, bool low_latency) {
+  (void)filecount;
+  (void)filenames;
+  (void)options;
+  (void)low_latency;
+  printf("Hotplug mode is only supported on Linux\n");
+  return false;
+}
+
+#endif
@@ -0,0 +1,18 @@
+#pragma once
+#include <stdbool.h>
+#include "ymodem.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Sends the files to every Agon that is plugged in from now on, until interrupted.
+ * Boards are recognized from kernel uevents by their USB-serial bridge, as in
+ * serial_find_profile(), and each one is served on a thread of its own.
+ * Returns false if hotplug events can't be received. Linux only.
+ */
+bool hotplug_send(int filecount, char **filenames, const ymodem_options_t *options, bool low_latency);
+
+#ifdef __cplusplus
+}
+#endif
@@ -11,15 +11,68 @@
 #include <sys/stat.h>
 
 #include "ymodem.h"
+#include "hotplug.h"
+#include "watch.h"
 #include "serial.h"
 #include "serial_enum_filtered.h"
 
 #define DEFAULT_BAUDRATE        115200
 
+enum {
+  OPT_STATS = 256,
+  OPT_LOW_LATENCY,
+  OPT_NO_LOW_LATENCY,
+  OPT_RTSCTS,
+  OPT_HOTPLUG,
+  OPT_WATCH,
+  OPT_LS,
+  OPT_CRC,
+  OPT_RM,
+  OPT_MKDIR,
+  OPT_MV
+};
+
+static const struct option long_options[] = {
+  {"stats", required_argument, NULL, OPT_STATS},
+  {"low-latency", no_argument, NULL, OPT_LOW_LATENCY},
+  {"no-low-latency", no_argument, NULL, OPT_NO_LOW_LATENCY},
+  {"rtscts", no_argument, NULL, OPT_RTSCTS},
+  {"hotplug", no_argument, NULL, OPT_HOTPLUG},
+  {"watch", required_argument, NULL, OPT_WATCH},
+  {"ls", required_argument, NULL, OPT_LS},
+  {"crc", no_argument, NULL, OPT_CRC},
+  {"rm", required_argument, NULL, OPT_RM},
+  {"mkdir", required_argument, NULL, OPT_MKDIR},
+  {"mv", required_argument, NULL, OPT_MV},
+  {NULL, 0, NULL, 0}
+};
+
+typedef enum {
+  LOW_LATENCY_AUTO,     // known USB-serial adapters only
+  LOW_LATENCY_ON,
+  LOW_LATENCY_OFF
+} low_latency_t;
+
 void usage(const char *progname) {
   printf("Usage:\n");
-  printf("  %s [-b baudrate] [-d device] -r [directory]       Receive mode, optional target directory\n", progname);
-  printf("  %s [-b baudrate] [-d device] -s file1 [file2 ...] Send mode, at least one file required\n", progname);
+  printf("  %s [-b baudrate] [-d device] -r [-a] [-g] [-q] [directory]  Receive mode, optional target directory\n", progname);
+  printf("  %s [-b baudrate] [-d device] -s [-R] [-q] file1 [file2 ...] Send mode, at least one file required\n", progname);
+  printf("  %s [-b baudrate] [-d device] [-q] --watch directory  Watch mode, sends files as they change in the directory tree\n", progname);
+  printf("  %s [-b baudrate] [-d device] [-q] -x command [directory]  Command to an Agon running 'ymodem -d':\n", progname);
+  printf("      'send name1 [name2 ...]', 'list [-c] [directory]' or 'exit'; files come back to the directory\n");
+  printf("  %s [-b baudrate] [-d device] --ls directory [--crc]  Lists a directory on an Agon running 'ymodem -d'\n", progname);
+  printf("  %s [-b baudrate] [-d device] [--rm path] [--mkdir path] [--mv from to] ...\n", progname);
+  printf("      Filesystem operations on an Agon running 'ymodem -d', all in one round trip, in the given order\n");
+  printf("  %s -c [-R] file1 [file2 ...]  Checksum mode, prints the CRC32 and size of each file to send\n", progname);
+  printf("  -R  Send directories recursively, subdirectories are created on the receiving side\n");
+  printf("  -a  Publish received files atomically, only when the entire batch is received\n");
+  printf("  -g  Receive with YMODEM-g, blocks are streamed without ACKs; for error free links with flow control\n");
+  printf("  -q  Quiet, no progress or status output\n");
+  printf("  --stats file.json  Write transfer statistics of the session to file.json\n");
+  printf("  --low-latency      Lower the driver latency of any serial adapter, not only known USB adapters\n");
+  printf("  --no-low-latency   Leave the driver latency settings alone\n");
+  printf("  --rtscts           Use RTS/CTS hardware flow control, if the adapter and cable support it\n");
+  printf("  --hotplug          With -s, send to every Agon plugged in from now on, until Ctrl-C\n");
 }
 
 int is_directory(const char *path) {
@@ -34,6 +87,14 @@ int is_directory(const char *path) {
 #endif
 }
 
+// Adds a line to the command for the Agon server
+static bool add_command(char *command, size_t size, const char *op, const char *from, const char *to) {
+  size_t length = strlen(command);
+  int written = snprintf(command + length, size - length, "%s %s%s%s\n", op, from, to ? " " : "", to ? to : "");
+
+  return (written > 0) && ((size_t)written < size - length);
+}
+
 int main(int argc, char** argv) {
   char devicename[NAME_MAX + 1];
   char *dir;
@@ -43,9 +104,20 @@ int main(int argc, char** argv) {
   bool auto_device = true;
   bool send = false;
   bool receive = false;
+  bool checksum = false;
+  bool rtscts = false;
+  bool hotplug = false;
+  const char *watch = NULL;
+  const char *command = NULL;
+  const char *list = NULL;
+  bool listcrc = false;
+  char operations[1024] = "";
+  char listcommand[PATH_MAX + 16];
+  low_latency_t low_latency = LOW_LATENCY_AUTO;
+  ymodem_options_t options = {0};
 
   // Process options
-  while ((opt = getopt(argc, argv, "srd:b:h")) != -1) {
+  while ((opt = getopt_long(argc, argv, "srcRagqd:b:x:h", long_options, NULL)) != -1) {
     switch (opt) {
     case 'd':
       device = optarg;
@@ -62,6 +134,58 @@ int main(int argc, char** argv) {
       if(send) { usage(basename(argv[0])); return -1;}
       receive = true;
       break;
+    case 'c':
+      checksum = true;
+      break;
+    case 'x':
+      command = optarg;
+      break;
+    case OPT_LS:
+      list = optarg;
+      break;
+    case OPT_CRC:
+      listcrc = true;
+      break;
+    case OPT_RM:
+    case OPT_MKDIR:
+    case OPT_MV:
+      if((opt == OPT_MV) && (optind >= argc)) { usage(basename(argv[0])); return -1; }
+      if(!add_command(operations, sizeof(operations), (opt == OPT_RM) ? "rm" : (opt == OPT_MKDIR) ? "mkdir" : "mv",
+                      optarg, (opt == OPT_MV) ? argv[optind++] : NULL)) {
+        printf("Too many operations\n");
+        return -1;
+      }
+      break;
+    case 'R':
+      options.recursive = true;
+      break;
+    case 'a':
+      options.atomic = true;
+      break;
+    case 'g':
+      options.streaming = true;
+      break;
+    case 'q':
+      options.quiet = true;
+      break;
+    case OPT_STATS:
+      options.stats_path = optarg;
+      break;
+    case OPT_LOW_LATENCY:
+      low_latency = LOW_LATENCY_ON;
+      break;
+    case OPT_NO_LOW_LATENCY:
+      low_latency = LOW_LATENCY_OFF;
+      break;
+    case OPT_RTSCTS:
+      rtscts = true;
+      break;
+    case OPT_HOTPLUG:
+      hotplug = true;
+      break;
+    case OPT_WATCH:
+      watch = optarg;
+      break;
     case 'h':
     default:
       usage(basename(argv[0]));
@@ -69,7 +193,45 @@ int main(int argc, char** argv) {
     }
   }
 
+  if(checksum) {
+    if(send || receive || options.atomic || (optind >= argc)) { usage(basename(argv[0])); return -1; }
+    return ymodem_checksum(argc - optind, &argv[optind], &options) ? 0 : -1;
+  }
+  if(list || operations[0] || listcrc) {
+    if(command || !list == !operations[0] || (listcrc && !list)) { usage(basename(argv[0])); return -1; }
+    if(list) {
+      snprintf(listcommand, sizeof(listcommand), "list %s%s", listcrc ? "-c " : "", list);
+      command = listcommand;
+    }
+    else command = operations;
+  }
+  if(command) {
+    if(send || receive || watch || hotplug || (argc - optind > 1)) { usage(basename(argv[0])); return -1; }
+    if((optind < argc) && (is_directory(argv[optind]) == 0)) {
+      printf("Invalid path \'%s\'\n", argv[optind]);
+      return -1;
+    }
+    receive = true;  // the port is opened as for a receive
+  }
+  if(watch) {
+    if(receive || hotplug || options.recursive || (optind < argc)) { usage(basename(argv[0])); return -1; }
+    if(is_directory(watch) == 0) {
+      printf("Invalid path \'%s\'\n", watch);
+      return -1;
+    }
+    send = true;
+  }
   if(!send && !receive) { usage(basename(argv[0])); return 0; }
+  if(options.recursive && !send) { usage(basename(argv[0])); return -1; }
+  if((options.atomic || options.streaming) && !receive) { usage(basename(argv[0])); return -1; }
+  if(hotplug && (!send || !auto_device || rtscts)) { usage(basename(argv[0])); return -1; }
+  options.baudrate = baud;
+
+  if(hotplug) {
+    if(optind >= argc) { usage(basename(argv[0])); return -1; }
+    return hotplug_send(argc - optind, &argv[optind], &options, low_latency != LOW_LATENCY_OFF) ? 0 : -1;
+  }
+
   // Autodetect devicename if none given as option
   if(auto_device && serial_autodetect(devicename) != 1) return -1;
 
@@ -79,16 +241,37 @@ int main(int argc, char** argv) {
     printf("Error %i from open: %s\n", errno, strerror(errno));
     return -1;
   }
+  if(low_latency != LOW_LATENCY_OFF) serial_low_latency(serial_port, device, low_latency == LOW_LATENCY_ON);
+  if(rtscts && (serial_flow_control(serial_port) != 1)) {
+    printf("No hardware flow control: the adapter doesn't support it or CTS isn't asserted\n");
+  }
 
   int filecount = argc - optind;
   char **filenames = &argv[optind];
 
+  if(command) {
+    char path[PATH_MAX];
+    int written = snprintf(path, sizeof(path), "%s", (optind < argc) ? argv[optind] : "./");
+    if((written > 0) && (written < (int)sizeof(path) - 1) && (path[written - 1] != '/')) strcat(path, "/");
+
+    ymodem_transfer_t *transfer = ymodem_transfer_open(serial_port, &options);
+    bool ok = transfer && ymodem_transfer_command(transfer, command, path);
+    if(transfer) ymodem_transfer_close(transfer);
+    serial_close(serial_port);
+    return ok ? 0 : -1;
+  }
+  if(watch) {
+    int result = watch_send(serial_port, watch, &options) ? 0 : -1;
+    serial_close(serial_port);
+    return result;
+  }
+
   if(send) {
     if(filecount <= 0) {
       usage(basename(argv[0]));
       return -1;
     }
-    ymodem_send(serial_port, filecount, filenames);
+    ymodem_send(serial_port, filecount, filenames, &options);
   }
 
   if(receive) {
@@ -115,12 +298,12 @@ int main(int argc, char** argv) {
       dir = malloc(3);
       strcpy(dir, "./");
     }
-    ymodem_receive(serial_port, dir);
+    ymodem_receive(serial_port, dir, &options);
     free(dir);
   }
 
   // Clean-up
-  close(serial_port);
+  serial_close(serial_port);
   return 0;
 }
 
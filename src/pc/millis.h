@@ -7,6 +7,7 @@ extern "C" {
 #endif
 
 uint64_t millis();
+uint64_t nanos();
 
 #ifdef __cplusplus
 }
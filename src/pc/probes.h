@@ -0,0 +1,32 @@
+#pragma once
+//
+// Static USDT tracepoints on the YMODEM protocol path, provider 'ymodem'.
+// Compiled in with 'make USDT=1', which needs <sys/sdt.h> (systemtap-sdt-dev).
+// Without it every probe compiles to nothing.
+//
+// Probes and arguments:
+//   frame_start(blocktype)                   first byte of a received frame
+//   frame_end(blocktype, length, timed_out)  received frame complete or incomplete
+//   crc(blocknumber, verified)               CRC verdict of a received frame
+//   duplicate(blocknumber)                   repeated block or EOT acknowledged again
+//   resync(skipped)                          noise skipped up to the next candidate header
+//   block_send(blocktype, blocknumber, size) frame written to the serial port
+//   ack(rtt_ns)                              ACK received for a sent frame
+//   nak()                                    NAK received for a sent frame
+//   cancel()                                 CAN received
+//   ack_send(), nak_send()                   ACK/NAK sent by the receiver
+//   retry(count)                             frame or EOT sent again
+//   timeout(timeout_ms)                      nothing received within timeout_ms
+
+#if defined(YMODEM_USDT) && defined(__linux__)
+#include <sys/sdt.h>
+#define YMODEM_PROBE0(name)                 DTRACE_PROBE(ymodem, name)
+#define YMODEM_PROBE1(name, a)              DTRACE_PROBE1(ymodem, name, a)
+#define YMODEM_PROBE2(name, a, b)           DTRACE_PROBE2(ymodem, name, a, b)
+#define YMODEM_PROBE3(name, a, b, c)        DTRACE_PROBE3(ymodem, name, a, b, c)
+#else
+#define YMODEM_PROBE0(name)                 do {} while(0)
+#define YMODEM_PROBE1(name, a)              do {} while(0)
+#define YMODEM_PROBE2(name, a, b)           do {} while(0)
+#define YMODEM_PROBE3(name, a, b, c)        do {} while(0)
+#endif
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "millis.h"
+#include "progress.h"
+
+Progress::Progress(bool quiet)
+    : _bytes(0),
+      _active(false),
+      _stop(false),
+      _number(0),
+      _size(0),
+      _file_start_ms(0),
+      _last_line_ms(0),
+      _last_bytes(0),
+      _last_ms(0),
+      _rate(0)
+{
+  _name[0] = 0;
+  if(quiet) _mode = PROGRESS_QUIET;
+  else _mode = isatty(STDOUT_FILENO) ? PROGRESS_TTY : PROGRESS_LINES;
+
+  if(_mode != PROGRESS_QUIET) _thread = std::thread(&Progress::run, this);
+}
+
+Progress::~Progress() {
+  stop();
+}
+
+void Progress::stop(void) {
+  {
+    std::lock_guard<std::mutex> guard(_output);
+    _stop = true;
+  }
+  _wake.notify_one();
+  if(_thread.joinable()) _thread.join();
+}
+
+static void format_rate(char *buffer, size_t length, double rate) {
+  if(rate >= 1024 * 1024) snprintf(buffer, length, "%.1f MiB/s", rate / (1024 * 1024));
+  else snprintf(buffer, length, "%.1f KiB/s", rate / 1024);
+}
+
+void Progress::startFile(unsigned int number, const char *name, uint64_t size) {
+  std::lock_guard<std::mutex> guard(_output);
+
+  _bytes.store(0, std::memory_order_relaxed);
+  _number = number;
+  snprintf(_name, sizeof(_name), "%s", name);
+  _size = size;
+  _file_start_ms = millis();
+  _last_line_ms = _file_start_ms;
+  _last_bytes = 0;
+  _last_ms = _file_start_ms;
+  _rate = 0;
+  _active = true;
+
+  // Without a terminal, the summary line from endFile() names the file
+  if(_mode != PROGRESS_TTY) return;
+  printf("\r                                                  \r");
+  printf("%u - %s\r\n", _number, _name);
+  fflush(stdout);
+}
+
+void Progress::endFile(void) {
+  std::lock_guard<std::mutex> guard(_output);
+  char rate[32];
+
+  if(!_active) return;
+  _active = false;
+  if(_mode == PROGRESS_QUIET) return;
+
+  uint64_t elapsed = millis() - _file_start_ms;
+  format_rate(rate, sizeof(rate), elapsed ? (_size * 1000.0) / elapsed : 0);
+  if(_mode == PROGRESS_TTY) printf("\r%llu/%llu  %s                    \r\n", (unsigned long long)_size, (unsigned long long)_size, rate);
+  else printf("%u - %s: %llu bytes in %.1fs, %s\n", _number, _name, (unsigned long long)_size, elapsed / 1000.0, rate);
+  fflush(stdout);
+}
+
+// Called with _output held
+void Progress::render(uint64_t now) {
+  uint64_t bytes = _bytes.load(std::memory_order_relaxed);
+  char rate[32];
+  char eta[32];
+
+  // Exponential moving average over the sample intervals
+  if(now > _last_ms) {
+    double sample = ((bytes - _last_bytes) * 1000.0) / (now - _last_ms);
+    _rate = (_rate == 0) ? sample : (0.8 * _rate) + (0.2 * sample);
+    _last_bytes = bytes;
+    _last_ms = now;
+  }
+
+  format_rate(rate, sizeof(rate), _rate);
+  if((_rate > 0) && (bytes <= _size)) {
+    unsigned int seconds = (unsigned int)((_size - bytes) / _rate);
+    snprintf(eta, sizeof(eta), "ETA %u:%02u", seconds / 60, seconds % 60);
+  }
+  else snprintf(eta, sizeof(eta), "ETA -:--");
+
+  if(_mode == PROGRESS_TTY) {
+    printf("\r%llu/%llu  %s  %s    ", (unsigned long long)bytes, (unsigned long long)_size, rate, eta);
+    fflush(stdout);
+  }
+  else if((now - _last_line_ms) >= PROGRESS_LINE_INTERVAL_MS) {
+    printf("%u - %s: %llu/%llu  %s  %s\n", _number, _name, (unsigned long long)bytes, (unsigned long long)_size, rate, eta);
+    fflush(stdout);
+    _last_line_ms = now;
+  }
+}
+
+void Progress::run(void) {
+  std::unique_lock<std::mutex> guard(_output);
+
+  while(!_stop) {
+    _wake.wait_for(guard, std::chrono::milliseconds(PROGRESS_INTERVAL_MS));
+    if(_active && !_stop) render(millis());
+  }
+}
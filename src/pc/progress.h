@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#define PROGRESS_INTERVAL_MS           100     // sampling rate of the renderer, 10Hz
+#define PROGRESS_LINE_INTERVAL_MS      5000    // interval between progress lines when not on a terminal
+#define PROGRESS_NAME_LENGTH           128
+
+typedef enum {
+  PROGRESS_QUIET,   // no progress output at all
+  PROGRESS_LINES,   // stdout is not a terminal, one line per file and a line every few seconds
+  PROGRESS_TTY      // single progress line, redrawn in place
+} progress_mode_t;
+
+// Renders transfer progress from its own thread, so the protocol loop never waits on stdout.
+// The protocol thread only stores the byte count; per-file lines are printed once per file.
+class Progress {
+  public:
+    Progress(bool quiet);
+   ~Progress();
+
+    void startFile(unsigned int number, const char *name, uint64_t size);
+    void update(uint64_t bytes) { _bytes.store(bytes, std::memory_order_relaxed); }
+    void endFile(void);
+    void stop(void);  // stops rendering, so the caller can print to stdout again
+
+  private:
+    void run(void);
+    void render(uint64_t now);
+
+    progress_mode_t _mode;
+    std::atomic<uint64_t> _bytes;
+
+    // Protected by _output
+    bool _active;
+    bool _stop;
+    char _name[PROGRESS_NAME_LENGTH];
+    unsigned int _number;
+    uint64_t _size;
+    uint64_t _file_start_ms;
+    uint64_t _last_line_ms;
+    uint64_t _last_bytes;
+    uint64_t _last_ms;
+    double _rate;
+    std::mutex _output;
+    std::condition_variable _wake;
+    std::thread _thread;
+};
@@ -1,9 +1,44 @@
 #include <fcntl.h>
 #include <string.h>
 #include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
 #include <termios.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
+#ifdef __linux__
+#include <linux/serial.h>
+#endif
+#include "serial.h"
+#include "serial_enum.h"
+
+#define SERIAL_MAX_TUNED        16
+#define SERIAL_LATENCY_TIMER    1       // ms, lowest the FTDI chips support
+#define SERIAL_CTS_WAIT         500     // ms the remote gets to assert CTS
+
+#define SERIAL_SLOT_FREE        0
+#define SERIAL_SLOT_BUSY        1       // being filled in or restored
+#define SERIAL_SLOT_TUNED       2
+
+// Driver settings changed by serial_low_latency(), restored when the port is closed.
+// Everything a restore writes is prepared here, as it may run in a signal handler.
+typedef struct {
+    int fd;
+    bool low_latency_set;               // ASYNC_LOW_LATENCY was off and has been set
+    char latency_path[PATH_MAX];
+    char latency_value[16];             // original latency_timer as written back, empty if unchanged
+    size_t latency_length;
+} serial_tuning_t;
+
+// Slots are taken and released with atomics only, no lock, so a signal handler can't deadlock
+static serial_tuning_t tuned[SERIAL_MAX_TUNED];
+static atomic_int tuned_state[SERIAL_MAX_TUNED];
+static pthread_once_t restore_once = PTHREAD_ONCE_INIT;
+static struct sigaction previous_int, previous_term;
 
 int serial_open(const char *path, int baud) {
     int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
@@ -55,7 +90,164 @@ error:
     return -1;
 }
 
+#ifdef __linux__
+static int read_int(const char *path) {
+    char buf[16];
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) return -1;
+    buf[n] = 0;
+    return atoi(buf);
+}
+
+static bool write_value(const char *path, const char *value, size_t length) {
+    int fd = open(path, O_WRONLY);
+    if (fd < 0) return false;
+
+    bool ok = (write(fd, value, length) == (ssize_t)length);
+    close(fd);
+    return ok;
+}
+
+static bool write_int(const char *path, int value) {
+    char buf[16];
+    int len = snprintf(buf, sizeof(buf), "%d", value);
+
+    return write_value(path, buf, len);
+}
+
+// Only system calls, for signal handlers
+static void restore(serial_tuning_t *t) {
+    struct serial_struct ss;
+
+    // Clear the flag first, the FTDI driver resets its latency timer with it
+    if (t->low_latency_set && ioctl(t->fd, TIOCGSERIAL, &ss) == 0) {
+        ss.flags &= ~ASYNC_LOW_LATENCY;
+        ioctl(t->fd, TIOCSSERIAL, &ss);
+    }
+    if (t->latency_length) write_value(t->latency_path, t->latency_value, t->latency_length);
+}
+
+// Restores the slot, unless another thread or a signal handler got to it first
+static void restore_slot(int i) {
+    int expected = SERIAL_SLOT_TUNED;
+
+    if (!atomic_compare_exchange_strong(&tuned_state[i], &expected, SERIAL_SLOT_BUSY)) return;
+    restore(&tuned[i]);
+    atomic_store(&tuned_state[i], SERIAL_SLOT_FREE);
+}
+
+// Driver settings go back to their original values, also on Ctrl-C
+static void restore_on_signal(int sig) {
+    serial_restore_all();
+    sigaction(sig, (sig == SIGINT) ? &previous_int : &previous_term, NULL);
+    raise(sig);
+}
+
+// Installed with the first change, signals that were ignored stay ignored
+static void install_restore(void) {
+    struct sigaction sa;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = restore_on_signal;
+    sigemptyset(&sa.sa_mask);
+    atexit(serial_restore_all);
+    if (sigaction(SIGINT, NULL, &previous_int) == 0 && previous_int.sa_handler != SIG_IGN) sigaction(SIGINT, &sa, NULL);
+    if (sigaction(SIGTERM, NULL, &previous_term) == 0 && previous_term.sa_handler != SIG_IGN) sigaction(SIGTERM, &sa, NULL);
+}
+#endif
+
+int serial_low_latency(int fd, const char *path, bool force) {
+#ifdef __linux__
+    char device[PATH_MAX];
+    char vid[8] = "", pid[8] = "";
+    struct serial_struct ss;
+    serial_tuning_t t;
+
+    // Resolve links like /dev/serial/by-id/... to the tty name
+    if (!realpath(path, device)) return -1;
+    const char *name = strrchr(device, '/') ? strrchr(device, '/') + 1 : device;
+
+    if (!force) {
+        if (!serial_linux_usb_ids(name, vid, pid, NULL, 0)) return 0;
+        const serial_profile_t *profile = serial_find_profile(vid, pid);
+        if (!profile || !profile->low_latency) return 0;
+    }
+
+    memset(&t, 0, sizeof(t));
+    t.fd = fd;
+
+    // Only present for FTDI adapters, and only writable with the right permissions
+    int timer = -1;
+    if (snprintf(t.latency_path, sizeof(t.latency_path), "/sys/bus/usb-serial/devices/%s/latency_timer", name) < (int)sizeof(t.latency_path))
+        timer = read_int(t.latency_path);
+
+    if (ioctl(fd, TIOCGSERIAL, &ss) == 0 && !(ss.flags & ASYNC_LOW_LATENCY)) {
+        ss.flags |= ASYNC_LOW_LATENCY;
+        t.low_latency_set = (ioctl(fd, TIOCSSERIAL, &ss) == 0);
+    }
+    if (timer > SERIAL_LATENCY_TIMER && write_int(t.latency_path, SERIAL_LATENCY_TIMER))
+        t.latency_length = snprintf(t.latency_value, sizeof(t.latency_value), "%d", timer);
+    if (!t.low_latency_set && !t.latency_length) return 0;
+
+    pthread_once(&restore_once, install_restore);
+    for (int i = 0; i < SERIAL_MAX_TUNED; i++) {
+        int expected = SERIAL_SLOT_FREE;
+        if (atomic_compare_exchange_strong(&tuned_state[i], &expected, SERIAL_SLOT_BUSY)) {
+            tuned[i] = t;
+            atomic_store(&tuned_state[i], SERIAL_SLOT_TUNED);
+            return 1;
+        }
+    }
+    restore(&t);    // can't track it, don't leave it changed
+    return 0;
+#else
+    (void)fd; (void)path; (void)force;
+    return 0;
+#endif
+}
+
+void serial_restore_all(void) {
+#ifdef __linux__
+    // Also called from signal handlers; only atomics and plain system calls below
+    for (int i = 0; i < SERIAL_MAX_TUNED; i++) restore_slot(i);
+#endif
+}
+
+int serial_flow_control(int fd) {
+    struct termios tio;
+    int status;
+
+    if (tcgetattr(fd, &tio) != 0) return -1;
+    tio.c_cflag |= CRTSCTS;
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) return -1;
+
+    // Drivers without hardware handshake drop the flag silently
+    if (tcgetattr(fd, &tio) != 0) return -1;
+    if (!(tio.c_cflag & CRTSCTS)) return 0;
+
+    // Without CTS from the remote nothing would ever be sent, the line may not be wired
+    for (int waited = 0; ; waited += 10) {
+        if (ioctl(fd, TIOCMGET, &status) != 0) break;
+        if (status & TIOCM_CTS) return 1;
+        if (waited >= SERIAL_CTS_WAIT) break;
+        usleep(10000);
+    }
+    tio.c_cflag &= ~CRTSCTS;
+    tcsetattr(fd, TCSANOW, &tio);
+    return 0;
+}
+
 void serial_close(int fd) {
+#ifdef __linux__
+    // A slot's fields don't change while it is tuned
+    for (int i = 0; i < SERIAL_MAX_TUNED; i++) {
+        if (atomic_load(&tuned_state[i]) == SERIAL_SLOT_TUNED && tuned[i].fd == fd) restore_slot(i);
+    }
+#endif
     close(fd);
 }
 
@@ -1,7 +1,29 @@
 #pragma once
+#include <stdbool.h>
 #include <unistd.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 int serial_open(const char *path, int baud);
-void serial_close(int fd);
+void serial_close(int fd);      // restores driver settings changed by serial_low_latency()
+
+/* Enables RTS/CTS hardware flow control, if the driver supports it and the remote
+ * asserts CTS. Returns 1 if enabled, 0 if it can't be used and is left off, negative on error.
+ */
+int serial_flow_control(int fd);
+
+/* Lowers the receive latency of USB-serial adapters: sets ASYNC_LOW_LATENCY and
+ * the FTDI latency_timer to 1 ms. Applied to known adapters, or to any port with 'force'.
+ * Returns 1 if anything was changed, 0 if not, negative on error. Linux only.
+ * The first change also restores all of them at exit and on SIGINT/SIGTERM.
+ */
+int serial_low_latency(int fd, const char *path, bool force);
+void serial_restore_all(void);  // async-signal-safe
+
+#ifdef __cplusplus
+}
+#endif
 ssize_t serial_write(int fd, const void *buf, size_t len);
 ssize_t serial_read(int fd, void *buf, size_t len);
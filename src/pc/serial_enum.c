@@ -1,3 +1,6 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 #include "serial_enum.h"
 
 #ifdef __linux__
@@ -20,3 +23,41 @@ int serial_enumerate(
     return serial_enumerate_platform(out, max_devices);
 }
 
+static const serial_profile_t profiles[] = {
+    {"1a86", "7523", "CH340",       true},
+    {"1a86", "55d4", "CH9102",      true},
+    {"0403", "6001", "FT232R",      true},
+    {"0403", "6010", "FT2232",      true},
+    {"0403", "6011", "FT4232",      true},
+    {"0403", "6014", "FT232H",      true},
+    {"0403", "6015", "FT-X",        true},
+    {"10c4", "ea60", "CP210x",      true},
+};
+
+static const serial_profile_t user_profile = {"", "", "YMODEM_USB_IDS", true};
+
+// "vid:pid" entries separated by commas
+static bool in_user_ids(const char *vendor_id, const char *product_id) {
+    const char *ids = getenv("YMODEM_USB_IDS");
+    size_t vlen = strlen(vendor_id), plen = strlen(product_id);
+
+    while (ids && *ids) {
+        size_t len = strcspn(ids, ",");
+        if (len == vlen + 1 + plen && ids[vlen] == ':' &&
+            !strncasecmp(ids, vendor_id, vlen) && !strncasecmp(ids + vlen + 1, product_id, plen))
+            return true;
+        ids += len;
+        if (*ids == ',') ids++;
+    }
+    return false;
+}
+
+const serial_profile_t *serial_find_profile(const char *vendor_id, const char *product_id) {
+    if (!vendor_id[0] || !product_id[0]) return NULL;
+
+    for (size_t i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+        if (!strcasecmp(vendor_id, profiles[i].vendor_id) && !strcasecmp(product_id, profiles[i].product_id))
+            return &profiles[i];
+    }
+    return in_user_ids(vendor_id, product_id) ? &user_profile : NULL;
+}
@@ -1,4 +1,6 @@
 #pragma once
+#include <stdbool.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -13,6 +15,25 @@ typedef struct {
     char serial[SERIAL_STR_MAX];     // device serial, "" if unknown
 } serial_device_t;
 
+/* USB-serial bridges known to work with the Agon, matched on VID/PID.
+ * Extra bridges can be given as YMODEM_USB_IDS="vid:pid[,vid:pid...]" in the environment.
+ */
+typedef struct {
+    const char *vendor_id;          // lower case hex, as in sysfs
+    const char *product_id;
+    const char *name;
+    bool low_latency;               // holds back received bytes, worth switching to low latency mode
+} serial_profile_t;
+
+const serial_profile_t *serial_find_profile(const char *vendor_id, const char *product_id);  // NULL if unknown
+
+#ifdef __linux__
+/* VID/PID (and serial, if not NULL) of the USB device behind a tty name like "ttyUSB0".
+ * Returns 1 if found, 0 if the tty isn't USB-backed.
+ */
+int serial_linux_usb_ids(const char *ttyname, char *vid, char *pid, char *serial, size_t serial_size);
+#endif
+
 /* Enumerate serial devices.
  * Return number of devices found or negative on error.
  */
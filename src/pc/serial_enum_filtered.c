@@ -2,33 +2,45 @@
 #include <string.h>
 #include <stdio.h>
 
+// Known bridges by VID/PID. Where the platform doesn't report those, by device name.
+static bool agon_compatible(const serial_device_t *dev) {
+    if (dev->vendor_id[0])
+        return serial_find_profile(dev->vendor_id, dev->product_id) != NULL;
+
+    return strstr(dev->devnode, "usbserial") ||
+           strstr(dev->devnode, "ttyUSB") ||
+           strstr(dev->devnode, "ttyACM");
+}
+
 int serial_enumerate_filtered( serial_device_t *out, int max_devices) {
     if (!out || max_devices <= 0)
         return -1;
 
-    serial_device_t tmp[64];   // internal scratch buffer
-    int total = serial_enumerate(tmp, 64);
+    int total = serial_enumerate(out, max_devices);
 
     if (total < 0)
         return -1;
 
     int count = 0;
-    for (int i = 0; i < total && count < max_devices; i++) {
-        const char *name = tmp[i].devnode;
-
-        if (!name)
-            continue;
-
-        if (strstr(name, "usbserial") ||
-            strstr(name, "ttyUSB") ||
-            strstr(name, "ttyACM")) {
-            out[count++] = tmp[i];  // struct copy
+    for (int i = 0; i < total; i++) {
+        if (agon_compatible(&out[i])) {
+            if (count != i) out[count] = out[i];  // struct copy
+            count++;
         }
     }
 
     return count;
 }
 
+static const char *describe(const serial_device_t *dev) {
+  static char text[64];
+  const serial_profile_t *profile = serial_find_profile(dev->vendor_id, dev->product_id);
+
+  text[0] = 0;
+  if(profile) snprintf(text, sizeof(text), " (%s %s:%s)", profile->name, dev->vendor_id, dev->product_id);
+  return text;
+}
+
 int serial_autodetect( char *devicename ) {
   serial_device_t filtered[16];
   int n = serial_enumerate_filtered(filtered, 16);
@@ -40,12 +52,12 @@ int serial_autodetect( char *devicename ) {
       printf("No USB-Serial devices found\n"); break;
     case 1:
       strcpy(devicename, filtered[0].devnode);
-      printf("Autodetected: %s\n", devicename);
+      printf("Autodetected: %s%s\n", devicename, describe(&filtered[0]));
       break;
     default:
       printf("Multiple devices found:\n"); 
       for(int i = 0; i < n; i++) {
-        printf("%d - %s\n", i, filtered[i].devnode);
+        printf("%d - %s%s\n", i, filtered[i].devnode, describe(&filtered[i]));
       }
       printf("\nSelect a device with the -d option\n");
   }
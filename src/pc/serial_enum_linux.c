@@ -1,61 +1,86 @@
 #ifdef __linux__
 
-#include <libudev.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "serial_enum.h"
 
+#define SYSFS_TTY           "/sys/class/tty"
+#define SYSFS_MAX_DEPTH     4   // tty interface to USB device: port, interface, device
+
+static void read_attr(const char *dir, const char *attr, char *value, size_t size) {
+    char path[PATH_MAX];
+
+    value[0] = 0;
+    if (snprintf(path, sizeof(path), "%s/%s", dir, attr) >= (int)sizeof(path)) return;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return;
+    ssize_t n = read(fd, value, size - 1);
+    close(fd);
+    if (n < 0) n = 0;
+    value[n] = 0;
+    value[strcspn(value, "\n")] = 0;
+}
+
+int serial_linux_usb_ids(const char *ttyname, char *vid, char *pid, char *serial, size_t serial_size) {
+    char path[PATH_MAX];
+    char dir[PATH_MAX];
+
+    if (snprintf(path, sizeof(path), SYSFS_TTY "/%s/device", ttyname) >= (int)sizeof(path)) return 0;
+    if (!realpath(path, dir)) return 0;
+
+    // Walk up from the tty's device to the USB device that has the descriptor attributes
+    for (int depth = 0; depth < SYSFS_MAX_DEPTH; depth++) {
+        read_attr(dir, "idVendor", vid, 8);
+        if (vid[0]) {
+            read_attr(dir, "idProduct", pid, 8);
+            if (serial) read_attr(dir, "serial", serial, serial_size);
+            return 1;
+        }
+        char *slash = strrchr(dir, '/');
+        if (!slash || slash == dir) break;
+        *slash = 0;
+    }
+    return 0;
+}
+
 int serial_enumerate_linux(
     serial_device_t *out,
     int max_devices
 ) {
-    struct udev *udev = udev_new();
-    if (!udev) return -1;
-
-    struct udev_enumerate *e = udev_enumerate_new(udev);
-    udev_enumerate_add_match_subsystem(e, "tty");
-    udev_enumerate_scan_devices(e);
+    DIR *d = opendir(SYSFS_TTY);
+    if (!d) return -1;
 
     int count = 0;
-    struct udev_list_entry *entry;
-
-    udev_list_entry_foreach(
-        entry, udev_enumerate_get_list_entry(e)) {
+    struct dirent *entry;
+    char path[PATH_MAX];
+    char link[PATH_MAX];
 
-        if (count >= max_devices)
-            break;
+    while ((entry = readdir(d)) && count < max_devices) {
+        if (entry->d_name[0] == '.') continue;
 
-        struct udev_device *d =
-            udev_device_new_from_syspath(
-                udev,
-                udev_list_entry_get_name(entry));
-
-        const char *node = udev_device_get_devnode(d);
-        if (!node) goto next;
+        // The class entry links to the device path; only USB-backed ttys have a USB bus in it.
+        // This skips the many ttyS and virtual consoles without touching their attributes.
+        if (snprintf(path, sizeof(path), SYSFS_TTY "/%s", entry->d_name) >= (int)sizeof(path)) continue;
+        ssize_t n = readlink(path, link, sizeof(link) - 1);
+        if (n <= 0) continue;
+        link[n] = 0;
+        if (!strstr(link, "/usb")) continue;
 
         serial_device_t *dev = &out[count];
         memset(dev, 0, sizeof(*dev));
 
-        strncpy(dev->devnode, node, sizeof(dev->devnode) - 1);
-
-        const char *vid =
-            udev_device_get_property_value(d, "ID_VENDOR_ID");
-        const char *pid =
-            udev_device_get_property_value(d, "ID_MODEL_ID");
-        const char *ser =
-            udev_device_get_property_value(d, "ID_SERIAL_SHORT");
-
-        if (vid) strncpy(dev->vendor_id, vid, sizeof(dev->vendor_id) - 1);
-        if (pid) strncpy(dev->product_id, pid, sizeof(dev->product_id) - 1);
-        if (ser) strncpy(dev->serial, ser, sizeof(dev->serial) - 1);
-
+        if (snprintf(dev->devnode, sizeof(dev->devnode), "/dev/%s", entry->d_name) >= (int)sizeof(dev->devnode)) continue;
+        if (!serial_linux_usb_ids(entry->d_name, dev->vendor_id, dev->product_id, dev->serial, sizeof(dev->serial))) continue;
         count++;
-
-    next:
-        udev_device_unref(d);
     }
 
-    udev_enumerate_unref(e);
-    udev_unref(udev);
+    closedir(d);
     return count;
 }
 
@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "millis.h"
+#include "stats.h"
+
+TransferStats::TransferStats(const char *path, const char *direction, int baudrate)
+    : _path(path),
+      _direction(direction),
+      _baudrate(baudrate),
+      _start_ns(nanos()),
+      _crc_start_ns(0),
+      _max_idle_ns(0),
+      _min_rtt_ns(0),
+      _max_rtt_ns(0)
+{
+  memset(_rtt_histogram, 0, sizeof(_rtt_histogram));
+  memset(&_total, 0, sizeof(_total));
+  memset(&_file_start, 0, sizeof(_file_start));
+}
+
+TransferStats::~TransferStats() {
+  if(_files.size() && (_files.back().end_ns == 0)) endFile(false);
+  if(_path) write();
+  for(stats_file_t &f : _files) free(f.name);
+}
+
+void TransferStats::startFile(const char *name, uint64_t size) {
+  stats_file_t f;
+
+  if(_files.size() && (_files.back().end_ns == 0)) endFile(false);
+
+  f.name = strdup(name);
+  f.size = size;
+  f.start_ns = nanos();
+  f.end_ns = 0;
+  f.complete = false;
+  memset(&f.counters, 0, sizeof(f.counters));
+  _files.push_back(f);
+  _file_start = _total;
+}
+
+// Per-file counters are the difference between the session counters at the start and end of the file
+void TransferStats::endFile(bool complete) {
+  if(_files.empty() || (_files.back().end_ns != 0)) return;
+
+  stats_file_t &f = _files.back();
+  const uint64_t *from = (const uint64_t *)&_file_start;
+  const uint64_t *to = (const uint64_t *)&_total;
+  uint64_t *delta = (uint64_t *)&f.counters;
+
+  for(size_t n = 0; n < sizeof(stats_counters_t) / sizeof(uint64_t); n++) delta[n] = to[n] - from[n];
+  f.end_ns = nanos();
+  f.complete = complete;
+}
+
+void TransferStats::startCrc(void) {
+  _crc_start_ns = nanos();
+}
+
+void TransferStats::endCrc(void) {
+  _total.crc_ns += nanos() - _crc_start_ns;
+}
+
+void TransferStats::ack(uint64_t rtt_ns) {
+  uint64_t limit = STATS_RTT_FIRST_BUCKET_US * 1000ULL;
+  int bucket = 0;
+
+  _total.acks++;
+  _total.ack_rtt_ns += rtt_ns;
+  if((_min_rtt_ns == 0) || (rtt_ns < _min_rtt_ns)) _min_rtt_ns = rtt_ns;
+  if(rtt_ns > _max_rtt_ns) _max_rtt_ns = rtt_ns;
+
+  while((bucket < STATS_RTT_BUCKETS - 1) && (rtt_ns > limit)) {
+    limit <<= 1;
+    bucket++;
+  }
+  _rtt_histogram[bucket]++;
+}
+
+void TransferStats::idle(uint64_t ns) {
+  if(ns < STATS_IDLE_GAP_NS) return;
+
+  _total.idle_gaps++;
+  _total.idle_ns += ns;
+  if(ns > _max_idle_ns) _max_idle_ns = ns;
+}
+
+static void write_string(FILE *fp, const char *s) {
+  fputc('\"', fp);
+  for(; *s; s++) {
+    unsigned char c = *s;
+    if((c == '\"') || (c == '\\')) fprintf(fp, "\\%c", c);
+    else if(c < 0x20) fprintf(fp, "\\u%04x", c);
+    else fputc(c, fp);
+  }
+  fputc('\"', fp);
+}
+
+// Common counters of the session and file objects
+static void write_counters(FILE *fp, const char *indent, const stats_counters_t *c, uint64_t duration_ns) {
+  double seconds = duration_ns / 1e9;
+  uint64_t line_bytes = c->line_bytes_tx + c->line_bytes_rx;
+
+  fprintf(fp, "%s\"duration_s\": %.6f,\n", indent, seconds);
+  fprintf(fp, "%s\"payload_bytes\": %llu,\n", indent, (unsigned long long)c->payload_bytes);
+  fprintf(fp, "%s\"line_bytes\": %llu,\n", indent, (unsigned long long)line_bytes);
+  fprintf(fp, "%s\"line_bytes_tx\": %llu,\n", indent, (unsigned long long)c->line_bytes_tx);
+  fprintf(fp, "%s\"line_bytes_rx\": %llu,\n", indent, (unsigned long long)c->line_bytes_rx);
+  fprintf(fp, "%s\"throughput_bytes_per_s\": %.1f,\n", indent, (seconds > 0) ? c->payload_bytes / seconds : 0.0);
+  fprintf(fp, "%s\"line_efficiency\": %.4f,\n", indent, line_bytes ? (c->payload_bytes * 8.0) / (line_bytes * STATS_BITS_PER_CHARACTER) : 0.0);
+  fprintf(fp, "%s\"blocks\": %llu,\n", indent, (unsigned long long)c->blocks);
+  fprintf(fp, "%s\"acks\": %llu,\n", indent, (unsigned long long)c->acks);
+  fprintf(fp, "%s\"naks\": %llu,\n", indent, (unsigned long long)c->naks);
+  fprintf(fp, "%s\"timeouts\": %llu,\n", indent, (unsigned long long)c->timeouts);
+  fprintf(fp, "%s\"retries\": %llu,\n", indent, (unsigned long long)c->retries);
+  fprintf(fp, "%s\"errors\": %llu,\n", indent, (unsigned long long)c->errors);
+  fprintf(fp, "%s\"cancels\": %llu,\n", indent, (unsigned long long)c->cancels);
+  fprintf(fp, "%s\"ack_rtt_mean_us\": %.1f,\n", indent, c->acks ? (c->ack_rtt_ns / 1e3) / c->acks : 0.0);
+  fprintf(fp, "%s\"crc_time_us\": %.1f,\n", indent, c->crc_ns / 1e3);
+  fprintf(fp, "%s\"idle_gaps\": %llu,\n", indent, (unsigned long long)c->idle_gaps);
+  fprintf(fp, "%s\"idle_time_s\": %.6f", indent, c->idle_ns / 1e9);
+}
+
+bool TransferStats::write(void) {
+  uint64_t duration_ns = nanos() - _start_ns;
+  double seconds = duration_ns / 1e9;
+
+  FILE *fp = fopen(_path, "w");
+  if(!fp) { printf("\nError opening \'%s\'\n", _path); return false; }
+
+  fprintf(fp, "{\n");
+  fprintf(fp, "  \"direction\": \"%s\",\n", _direction);
+  fprintf(fp, "  \"baudrate\": %d,\n", _baudrate);
+  fprintf(fp, "  \"files_total\": %zu,\n", _files.size());
+  write_counters(fp, "  ", &_total, duration_ns);
+  fprintf(fp, ",\n");
+  if(_baudrate > 0) {
+    uint64_t line_bytes = _total.line_bytes_tx + _total.line_bytes_rx;
+    fprintf(fp, "  \"line_utilization\": %.4f,\n", (seconds > 0) ? (line_bytes * STATS_BITS_PER_CHARACTER) / (_baudrate * seconds) : 0.0);
+  }
+  fprintf(fp, "  \"idle_gap_max_s\": %.6f,\n", _max_idle_ns / 1e9);
+  fprintf(fp, "  \"ack_rtt_us\": {\n");
+  fprintf(fp, "    \"min\": %.1f,\n", _min_rtt_ns / 1e3);
+  fprintf(fp, "    \"max\": %.1f,\n", _max_rtt_ns / 1e3);
+  fprintf(fp, "    \"histogram\": [");
+  for(int n = 0; n < STATS_RTT_BUCKETS; n++) {
+    if(n < STATS_RTT_BUCKETS - 1) fprintf(fp, "%s\n      {\"le_us\": %llu, \"count\": %llu}", n ? "," : "", (unsigned long long)STATS_RTT_FIRST_BUCKET_US << n, (unsigned long long)_rtt_histogram[n]);
+    else fprintf(fp, ",\n      {\"le_us\": null, \"count\": %llu}", (unsigned long long)_rtt_histogram[n]);
+  }
+  fprintf(fp, "\n    ]\n  },\n");
+
+  fprintf(fp, "  \"files\": [");
+  for(size_t n = 0; n < _files.size(); n++) {
+    stats_file_t &f = _files[n];
+    fprintf(fp, "%s\n    {\n      \"name\": ", n ? "," : "");
+    write_string(fp, f.name);
+    fprintf(fp, ",\n      \"size\": %llu,\n", (unsigned long long)f.size);
+    fprintf(fp, "      \"complete\": %s,\n", f.complete ? "true" : "false");
+    write_counters(fp, "      ", &f.counters, f.end_ns - f.start_ns);
+    fprintf(fp, "\n    }");
+  }
+  fprintf(fp, "\n  ]\n}\n");
+
+  bool ok = (ferror(fp) == 0);
+  if(fclose(fp) != 0) ok = false;
+  if(!ok) printf("\nError writing \'%s\'\n", _path);
+  return ok;
+}
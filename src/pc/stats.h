@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "ymodem_engine.h"
+
+#define STATS_RTT_BUCKETS              18    // powers of two, from <= 64us up to > 4s
+#define STATS_RTT_FIRST_BUCKET_US      64
+#define STATS_IDLE_GAP_NS              2000000ULL
+#define STATS_BITS_PER_CHARACTER       10    // 8N1
+
+typedef struct {
+  uint64_t payload_bytes;
+  uint64_t line_bytes_tx;
+  uint64_t line_bytes_rx;
+  uint64_t blocks;
+  uint64_t naks;
+  uint64_t timeouts;
+  uint64_t retries;
+  uint64_t errors;
+  uint64_t cancels;
+  uint64_t acks;
+  uint64_t ack_rtt_ns;
+  uint64_t crc_ns;
+  uint64_t idle_gaps;
+  uint64_t idle_ns;
+} stats_counters_t;
+
+typedef struct {
+  char *name;
+  uint64_t size;
+  uint64_t start_ns;
+  uint64_t end_ns;
+  bool complete;
+  stats_counters_t counters;
+} stats_file_t;
+
+// Transfer statistics for one session, written as a JSON report when the session ends.
+// Counting is always on, the report is only written if a path was given.
+class TransferStats : public YMODEMStats {
+  public:
+    TransferStats(const char *path, const char *direction, int baudrate);
+   ~TransferStats();
+
+    void startFile(const char *name, uint64_t size) override;
+    void endFile(bool complete) override;
+
+    void payload(size_t bytes) override { _total.payload_bytes += bytes; }
+    void tx(size_t bytes) override { _total.line_bytes_tx += bytes; }
+    void rx(size_t bytes) override { _total.line_bytes_rx += bytes; }
+    void block(void) override { _total.blocks++; }
+    void nak(void) override { _total.naks++; }
+    void timeout(void) override { _total.timeouts++; }
+    void retry(void) override { _total.retries++; }
+    void error(void) override { _total.errors++; }
+    void cancel(void) override { _total.cancels++; }
+    void startCrc(void) override;
+    void endCrc(void) override;
+    void ack(uint64_t rtt_ns) override;
+    void idle(uint64_t ns) override;
+
+    bool write(void);
+
+  private:
+    const char *_path;
+    const char *_direction;
+    int _baudrate;
+    uint64_t _start_ns;
+    uint64_t _crc_start_ns;
+    uint64_t _max_idle_ns;
+    uint64_t _min_rtt_ns;
+    uint64_t _max_rtt_ns;
+    uint64_t _rtt_histogram[STATS_RTT_BUCKETS];
+    stats_counters_t _total;
+    stats_counters_t _file_start;
+    std::vector<stats_file_t> _files;
+};
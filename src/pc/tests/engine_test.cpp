@@ -0,0 +1,158 @@
+// Protocol engine tests, fed with hand-built frames. Build and run with 'make test'.
+#include <stdio.h>
+#include <string.h>
+#include "../ymodem_engine.h"
+#include "../Crc.h"
+
+#define NS_PER_MS 1000000ULL
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+  if(!(cond)) { \
+    fprintf(stderr, "%s:%d: %s: check failed: %s\n", __FILE__, __LINE__, __func__, #cond); \
+    failures++; \
+  } \
+} while(0)
+
+// Records what the receiver does with the files
+class TestSink : public YMODEMSink {
+  public:
+    bool open(const char *name, uint64_t size) override { (void)name; (void)size; opened++; return true; }
+    bool write(const uint8_t *data, size_t length) override { (void)data; written += length; return true; }
+    bool close(void) override { closed++; return true; }
+    bool finish(bool complete) override { (void)complete; return true; }
+
+    int opened = 0;
+    int closed = 0;
+    size_t written = 0;
+};
+
+// Receiver driven by hand, collects its responses
+class TestReceiver {
+  public:
+    TestReceiver() : _engine(_sink), _now(0) {
+      _engine.start(_now);
+      _now += YMODEM_FLUSHTIME * NS_PER_MS;
+      _engine.poll(_now);
+      drain();
+    }
+
+    void feed(const uint8_t *data, size_t length) {
+      _now += NS_PER_MS;
+      _engine.receive(data, length, _now);
+    }
+    void feed(uint8_t c) { feed(&c, 1); }
+
+    // Builds a 128 byte block; the header block carries name and size
+    static size_t build(uint8_t *frame, uint8_t seq, const char *payload, size_t length) {
+      frame[0] = YMODEM_SOH;
+      frame[YMODEM_BLOCK_SEQ_INDEX] = seq;
+      frame[YMODEM_BLOCK_SEQ_COMP_INDEX] = 255 - seq;
+      memset(frame + YMODEM_BLOCK_HEADER, 0, YMODEM_BLOCKSIZE_128);
+      memcpy(frame + YMODEM_BLOCK_HEADER, payload, length);
+      uint16_t crc = Crc16Xmodem::compute(frame + YMODEM_BLOCK_HEADER, YMODEM_BLOCKSIZE_128);
+      frame[YMODEM_BLOCK_HEADER + YMODEM_BLOCKSIZE_128] = crc >> 8;
+      frame[YMODEM_BLOCK_HEADER + YMODEM_BLOCKSIZE_128 + 1] = crc & 0xff;
+      return YMODEM_BLOCKSIZE_128 + YMODEM_BLOCK_OVERHEAD;
+    }
+    void block(uint8_t seq, const char *payload, size_t length) {
+      uint8_t frame[YMODEM_BLOCKSIZE_128 + YMODEM_BLOCK_OVERHEAD];
+      feed(frame, build(frame, seq, payload, length));
+    }
+    void header(const char *name, const char *size) {
+      char payload[YMODEM_BLOCKSIZE_128] = {0};
+      strcpy(payload, name);
+      strcpy(payload + strlen(name) + 1, size);
+      block(0, payload, strlen(name) + 1 + strlen(size));
+    }
+
+    // Responses queued since the last call
+    size_t drain(void) {
+      const uint8_t *p;
+      size_t n, total = 0;
+      while((n = _engine.output(&p)) > 0) {
+        if(total + n > sizeof(_response)) n = sizeof(_response) - total;
+        memcpy(_response + total, p, n);
+        total += n;
+        _engine.sent(n, _now);
+        if(total == sizeof(_response)) break;
+      }
+      _response_length = total;
+      return total;
+    }
+    bool responded(uint8_t c) { return (_response_length > 0) && (_response[0] == c); }
+
+    TestSink _sink;
+    YMODEMReceiver _engine;
+    uint64_t _now;
+    uint8_t _response[64];
+    size_t _response_length = 0;
+};
+
+// An EOT before all announced data is NAKed, repeated it fails the session without closing the file
+static void test_early_eot(void) {
+  TestReceiver r;
+  r.header("a.bin", "300");
+  r.drain();
+  CHECK(r._sink.opened == 1);
+  r.block(1, "data", 4);
+  r.drain();
+  CHECK(r.responded(YMODEM_ACK));
+
+  r.feed(YMODEM_EOT);
+  r.drain();
+  CHECK(r.responded(YMODEM_NAK));
+  CHECK(r._sink.closed == 0);
+  CHECK(r._engine.status() == YMODEM_RUNNING);
+
+  r.feed(YMODEM_EOT);
+  r.drain();
+  CHECK(r._sink.closed == 0);
+  CHECK(r._engine.status() == YMODEM_FAILED);
+}
+
+// A noise byte that looks like EOT does not take the block behind it along
+static void test_eot_noise(void) {
+  TestReceiver r;
+  r.header("a.bin", "300");
+  r.drain();
+
+  uint8_t frame[1 + YMODEM_BLOCKSIZE_128 + YMODEM_BLOCK_OVERHEAD];
+  frame[0] = YMODEM_EOT;
+  r.feed(frame, 1 + TestReceiver::build(frame + 1, 1, "data", 4));
+  r.drain();
+  CHECK(r._sink.closed == 0);
+  CHECK(r._sink.written == YMODEM_BLOCKSIZE_128);
+  CHECK(r._response_length >= 2);
+  CHECK(r._response[r._response_length - 1] == YMODEM_ACK);
+  CHECK(r._engine.status() == YMODEM_RUNNING);
+}
+
+// An EOT after all announced data closes the file
+static void test_eot(void) {
+  TestReceiver r;
+  r.header("a.bin", "100");
+  r.drain();
+  r.block(1, "data", 4);
+  r.drain();
+  r.feed(YMODEM_EOT);
+  r.drain();
+  CHECK(r.responded(YMODEM_ACK));
+  CHECK(r._sink.closed == 1);
+  CHECK(r._sink.written == 100);
+  CHECK(r._engine.status() == YMODEM_RUNNING);
+}
+
+int main(void) {
+  test_early_eot();
+  test_eot_noise();
+  test_eot();
+
+  if(failures) {
+    fprintf(stderr, "%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("All tests passed\n");
+  return 0;
+}
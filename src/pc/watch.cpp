@@ -0,0 +1,207 @@
+#include <exception>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "filewalk.h"
+#include "watch.h"
+
+#ifdef __linux__
+
+#include <dirent.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#define WATCH_DEBOUNCE                 300   // ms without changes before a batch is sent
+#define WATCH_EVENT_BUFFER             16384
+#define WATCH_MASK                     (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE)
+
+// Changed files below a directory, collected from inotify until they are taken as a batch
+class Watcher {
+  public:
+    Watcher(const char *dir) : _dir(dir), _fd(-1) {}
+   ~Watcher() { if(_fd >= 0) close(_fd); }
+
+    bool start(void);
+    int fd(void) { return _fd; }
+    bool read(void);                        // false on an error of the inotify descriptor
+    bool pending(void) { return !_changed.empty(); }
+    std::vector<std::string> take(void);    // changed files that still exist, sorted
+    void retry(const std::vector<std::string> &files) { _failed.insert(files.begin(), files.end()); }  // go with the next batch
+
+  private:
+    bool add(const std::string &rel, bool collect);
+    static bool skipped(const char *name);
+
+    std::string _dir;
+    int _fd;
+    std::map<int, std::string> _dirs;       // watch descriptor to directory, relative to _dir
+    std::set<std::string> _changed;         // relative to _dir
+    std::set<std::string> _failed;          // from a failed batch
+};
+
+// Editor backup and swap files, and hidden files
+bool Watcher::skipped(const char *name) {
+  size_t length = strlen(name);
+
+  return (name[0] == '.') || (length == 0) || (name[length - 1] == '~') || (strcmp(name, "4913") == 0);
+}
+
+bool Watcher::start(void) {
+  _fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+  if(_fd < 0) {
+    printf("Error %i from inotify: %s\n", errno, strerror(errno));
+    return false;
+  }
+  return add("", false);
+}
+
+// Watches a directory and everything below it. New directories may already have
+// files in them by the time they are watched, those are collected with 'collect'.
+bool Watcher::add(const std::string &rel, bool collect) {
+  std::string path = rel.empty() ? _dir : _dir + "/" + rel;
+  struct dirent *de;
+  struct stat st;
+
+  int wd = inotify_add_watch(_fd, path.c_str(), WATCH_MASK);
+  if(wd < 0) {
+    printf("Error watching \'%s\': %s\n", path.c_str(), strerror(errno));
+    return false;
+  }
+  _dirs[wd] = rel;  // also renames a directory that was moved within the tree
+
+  DIR *d = opendir(path.c_str());
+  if(!d) return true;  // already gone again
+  while((de = readdir(d)) != NULL) {
+    if(skipped(de->d_name)) continue;
+
+    std::string child = rel.empty() ? de->d_name : rel + "/" + de->d_name;
+    if(stat((_dir + "/" + child).c_str(), &st) != 0) continue;
+    if(S_ISDIR(st.st_mode)) add(child, collect);
+    else if(collect && S_ISREG(st.st_mode)) _changed.insert(child);
+  }
+  closedir(d);
+  return true;
+}
+
+bool Watcher::read(void) {
+  alignas(struct inotify_event) char buffer[WATCH_EVENT_BUFFER];
+
+  while(1) {
+    ssize_t length = ::read(_fd, buffer, sizeof(buffer));
+    if(length < 0) return (errno == EAGAIN) || (errno == EINTR);
+
+    for(char *p = buffer; p < buffer + length; p += sizeof(struct inotify_event) + ((struct inotify_event *)p)->len) {
+      const struct inotify_event *event = (const struct inotify_event *)p;
+
+      if(event->mask & IN_Q_OVERFLOW) {
+        printf("Too many changes at once, the whole tree is sent\n");
+        add("", true);
+        continue;
+      }
+      if(event->mask & IN_IGNORED) {
+        _dirs.erase(event->wd);
+        continue;
+      }
+
+      auto dir = _dirs.find(event->wd);
+      if((dir == _dirs.end()) || (event->len == 0) || skipped(event->name)) continue;
+
+      std::string rel = dir->second.empty() ? event->name : dir->second + "/" + event->name;
+      if(event->mask & IN_ISDIR) {
+        if(event->mask & (IN_CREATE | IN_MOVED_TO)) add(rel, true);
+      }
+      else if(event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) _changed.insert(rel);
+    }
+  }
+}
+
+std::vector<std::string> Watcher::take(void) {
+  std::vector<std::string> files;
+  struct stat st;
+
+  _changed.insert(_failed.begin(), _failed.end());
+  _failed.clear();
+  for(const std::string &rel : _changed) {
+    if((stat((_dir + "/" + rel).c_str(), &st) != 0) || !S_ISREG(st.st_mode)) continue;  // deleted again
+    if(rel.size() > FILEWALK_MAX_NAME_LENGTH) {
+      printf("Name too long \'%s\', not sent\n", rel.c_str());
+      continue;
+    }
+    files.push_back(rel);
+  }
+  _changed.clear();
+  return files;
+}
+
+static bool watch_send_cpp(int port, const char *dir, const ymodem_options_t *options) {
+  ymodem_options_t batch = *options;
+  Watcher watcher(dir);
+
+  if(!watcher.start()) return false;
+
+  batch.root = dir;
+  batch.recursive = false;
+  ymodem_transfer_t *transfer = ymodem_transfer_open(port, &batch);
+  if(!transfer) return false;
+
+  printf("Watching %s, Ctrl-C to stop\n", dir);
+  fflush(stdout);
+
+  struct pollfd pfd = {watcher.fd(), POLLIN, 0};
+  bool ok = true;
+  while(ok) {
+    int ready = poll(&pfd, 1, watcher.pending() ? WATCH_DEBOUNCE : -1);
+    if(ready < 0) {
+      if(errno == EINTR) continue;
+      ok = false;
+      break;
+    }
+    if(ready > 0) {
+      ok = watcher.read();
+      continue;  // changes still coming in, wait for quiet
+    }
+
+    std::vector<std::string> files = watcher.take();
+    if(files.empty()) continue;
+
+    std::vector<char *> names;
+    for(std::string &f : files) names.push_back(&f[0]);
+    printf("%zu changed file%s\n", names.size(), (names.size() == 1) ? "" : "s");
+    if(!ymodem_transfer_send(transfer, (int)names.size(), names.data())) {
+      printf("Changes are sent again with the next batch\n");
+      watcher.retry(files);
+    }
+    fflush(stdout);
+  }
+  if(!ok) printf("Error %i watching \'%s\': %s\n", errno, dir, strerror(errno));
+  ymodem_transfer_close(transfer);
+  return ok;
+}
+
+extern "C" bool watch_send(int port, const char *dir, const ymodem_options_t *options) {
+  try {
+    return watch_send_cpp(port, dir, options);
+  }
+  catch(const std::exception &e) {
+    printf("%s\n", e.what());
+    return false;
+  }
+}
+
+#else
+
+extern "C" bool watch_send(int port, const char *dir, const ymodem_options_t *options) {
+  (void)port;
+  (void)dir;
+  (void)options;
+  printf("Watch mode is only supported on Linux\n");
+  return false;
+}
+
+#endif
@@ -0,0 +1,18 @@
+#pragma once
+#include <stdbool.h>
+#include "ymodem.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Watches a directory tree and sends the files that change in it, until interrupted.
+ * Changes are collected until the tree has been quiet for a moment, then sent as one
+ * batch on the already open port, under their name relative to 'dir'.
+ * Returns false if the directory can't be watched. Linux only.
+ */
+bool watch_send(int port, const char *dir, const ymodem_options_t *options);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,44 +1,33 @@
 #include <cstdio>
 #include <stdexcept>
+#include <string>
+#include <vector>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <libgen.h>
-#include "CRC16.h"
-#include "CRC32.h"
+#include <errno.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include "arena.h"
+#include "checksum.h"
+#include "diskwriter.h"
+#include "filewalk.h"
 #include "millis.h"
+#include "progress.h"
 #include "serial.h"
-
-// YMODEM protocol constants
-#define YMODEM_MAX_NAME_LENGTH         100
-#define YMODEM_BLOCK_SEQ_INDEX         1
-#define YMODEM_BLOCK_SEQ_COMP_INDEX    2
-#define YMODEM_BLOCK_HEADER            3
-#define YMODEM_BLOCK_TRAILER           2
-#define YMODEM_BLOCK_OVERHEAD          (YMODEM_BLOCK_HEADER + YMODEM_BLOCK_TRAILER)
-#define YMODEM_BLOCKSIZE_128           128
-#define YMODEM_BLOCKSIZE_1K            1024
-#define YMODEM_MOS_BLOCK               1024
-#define YMODEM_FILESIZEDATA_LENGTH     16
-#define YMODEM_MAXFILES                128
-#define YMODEM_SOH                     0x01  // 128 byte data block
-#define YMODEM_STX                     0x02  // 1024 byte data block
-#define YMODEM_EOT                     0x04
-#define YMODEM_ACK                     0x06
-#define YMODEM_NAK                     0x15
-#define YMODEM_CAN                     0x18
-#define YMODEM_DEFCRC16                0x43
-#define YMODEM_TIMEOUT                 1200
-#define YMODEM_FLUSHTIME               200
-#define YMODEM_MAX_ERRORS              32
-#define YMODEM_MAX_RETRY               3
-
-// Global variables
-bool                  ymodem_session_aborted;
-static uint8_t        ymodem_fullblockbuffer[1+ YMODEM_BLOCKSIZE_1K + YMODEM_BLOCK_OVERHEAD];  // header + seq + ~seq + data + CRC
-static uint8_t        ymodem_tmpbuffer[YMODEM_BLOCKSIZE_1K];                                   // padded block buffer
-static uint8_t        ymodem_block0[YMODEM_BLOCKSIZE_128];
-int                   serial_port;
+#include "stats.h"
+#include "ymodem.h"
+#include "ymodem_engine.h"
+
+#define YMODEM_FILETABLE_PAGE          256   // entries per page of a session's file table
+#define YMODEM_RX_BUFFER               2048
+#define YMODEM_COMMAND_NAME            ".ymodem"      // command file for an Agon running 'ymodem -d'
+#define YMODEM_LISTING_NAME            ".ymodem.lst"  // its reply to a 'list' command
+#define YMODEM_RESULT_NAME             ".ymodem.res"  // its reply to filesystem operations, a byte per operation
+#define YMODEM_COMMAND_LENGTH          1023           // command buffer of the Agon server
+#define YMODEM_LIST_CRC                0x01           // listing flag: records carry the CRC32 of each file
+#define YMODEM_BAD_OPERATION           0xFF
 
 typedef struct {
   char *buffer;
@@ -48,166 +37,6 @@ typedef struct {
   size_t received;
 } ymodem_fileinfo_t;
 
-struct ymodem_block_t {
-    uint8_t  *data;
-    uint8_t   blocktype;
-    uint8_t   blocknumber;
-    uint32_t  length;
-    uint32_t  filesize;
-    char      filename[YMODEM_MAX_NAME_LENGTH];
-    bool      timed_out;
-    bool      end_of_batch;
-    bool      crc_verified;
-    bool      correct_blocknumber;
-
-    // constructor to initialize defaults
-    ymodem_block_t()
-        : data(ymodem_fullblockbuffer),
-          blocktype(0),
-          blocknumber(0),
-          length(0),
-          filesize(0),
-          timed_out(false),
-          end_of_batch(false),
-          crc_verified(false),
-          correct_blocknumber(false)
-    {
-        filename[0] = '\0';
-    }
-};
-// Read a single byte from the external serial port, until timeout
-static bool serialRx_byte_t (uint8_t *c, uint64_t timeout_ms) {
-  uint64_t timeReceived = millis();
-
-  while((millis() - timeReceived) < timeout_ms) {
-    //printf("%d\n", (int)millis());
-    if(read(serial_port, c, 1) == 1) {
-      //printf("Read value: 0x%0X\n", *c);
-      return true;
-    }
-  }
-  return false;
-}
-
-static void send_ack (void) {
-  uint8_t c = YMODEM_ACK;
-  [[maybe_unused]] auto _ = write(serial_port, &c, 1);
-}
-static void send_nak (void) {
-  uint8_t c = YMODEM_NAK;
-  [[maybe_unused]] auto _ = write(serial_port, &c, 1);
-}
-static void send_reqcrc (void) {
-  uint8_t c = YMODEM_DEFCRC16;
-  [[maybe_unused]] auto _ = write(serial_port, &c, 1);
-}
-static void send_abort (void) {
-  uint8_t c[] = {YMODEM_CAN,YMODEM_CAN};
-  [[maybe_unused]] auto _ = write(serial_port, &c, 2);
-}
-
-// Eat all uart RX during a specific time period
-static void uart_flush(void) {
-  uint64_t timeReceived = millis();
-  uint8_t c;
-
-  while(millis() - timeReceived < YMODEM_FLUSHTIME) {
-    [[maybe_unused]] auto _ = read(serial_port, &c, 1);
-  }
-  return;
-}
-
-static int io_write(const uint8_t *data, int len) {
-    [[maybe_unused]] auto _ = write(serial_port, data, len);
-  return len;
-}
-
-static void wipe32chars_restartline(void) {
-  printf("\r                                \r");
-}
-
-static bool is_end_of_batch(ymodem_block_t *block) {
-  return ((block->length > YMODEM_BLOCK_HEADER) && (block->blocknumber == 0) && (block->data[YMODEM_BLOCK_HEADER] == 0));
-}
-
-static void get_block(ymodem_block_t *block, uint8_t blocknumber) {
-  CRC16 crc16result(0x1021); // Ymodem uses CRC-16-CCITT polynomial
-  int bytecount, block_size;
-  char file_length_data[YMODEM_BLOCKSIZE_128];
-  uint8_t input_byte;
-  uint8_t *data_start = block->data;
-  uint8_t *data = block->data;
-
-  block->length = 0;
-  block->timed_out = false;
-  block->crc_verified = false;
-  block->correct_blocknumber = false;
-  block->blocknumber = 0;
-  block->end_of_batch = false;
-
-  if (serialRx_byte_t(&input_byte, YMODEM_TIMEOUT) == false) {
-    block->timed_out = true;
-    return;
-  }
-  block->length = 1;
-  block->blocktype = input_byte;
-
-  switch (input_byte) {
-    case YMODEM_SOH:
-      block_size = YMODEM_BLOCKSIZE_128;
-      bytecount = YMODEM_BLOCKSIZE_128 + YMODEM_BLOCK_OVERHEAD - 1;
-  		break;
-    case YMODEM_STX:
-      block_size = YMODEM_BLOCKSIZE_1K;
-      bytecount = YMODEM_BLOCKSIZE_1K + YMODEM_BLOCK_OVERHEAD - 1;
-      break;
-    case YMODEM_EOT:
-    case YMODEM_CAN:
-    default:
-      return;
-  }
-
-  *data++ = input_byte;
-  for (int i = 0; i < bytecount; i++) {
-	  if (serialRx_byte_t(&input_byte, YMODEM_TIMEOUT) == false) {
-      block->timed_out = true;
-      block->end_of_batch = is_end_of_batch(block);
-      return; // block incomplete
-    }
-    block->length++;
-	  *data++ = input_byte;
-  }
-  // complete block
-  
-  // check crc
-  crc16result.restart();
-  crc16result.add(&data_start[YMODEM_BLOCK_HEADER], block_size + YMODEM_BLOCK_TRAILER);
-  block->crc_verified = (crc16result.calc() == 0);
-
-  // check blocknumber
-  block->blocknumber = block->data[YMODEM_BLOCK_SEQ_INDEX];
-  block->correct_blocknumber = (block->blocknumber == blocknumber);
-  block->correct_blocknumber = block->correct_blocknumber && (block->data[YMODEM_BLOCK_SEQ_COMP_INDEX] == (255 - block->blocknumber));
-  
-  size_t i;
-  uint8_t *tmp;
-  // parse header filename
-  for (i = 0, tmp = block->data + YMODEM_BLOCK_HEADER; ((*tmp != 0) && (i < YMODEM_MAX_NAME_LENGTH)); i++) block->filename[i] = *tmp++;
-  block->filename[i] = 0;
-
-  // parse header filesize
-  while((*tmp !=0) && (i < block->length)) tmp++;
-  for (i = 0, tmp++; (*tmp != ' ') && (i < YMODEM_FILESIZEDATA_LENGTH);) file_length_data[i++] = *tmp++;
-  file_length_data[i] = 0;
-  if (strlen(file_length_data) > 0) block->filesize = strtol(file_length_data, NULL, 10);
-  else block->filesize = 0;
-
-  // check end-of-batch
-  block->end_of_batch = is_end_of_batch(block);
-
-  return;  
-}
-
 class YMODEMSession {
   public:
     YMODEMSession();
@@ -215,13 +44,16 @@ class YMODEMSession {
     bool open(void);
     void close(const char *message);
     
-    void debug(void);
 
     bool addFile(const char* filename, size_t filesize);
     bool addFile(const char* dir, const char *filename, size_t filesize);
     bool addData(const uint8_t *data, size_t length);
-    bool writeFiles(void); // Sends all stored files to the YMODEM utility
-    bool readFiles(int filecount, char ** filenames); // Reads all files from the YMODEM utility to memory
+    bool checkLastFile(void);
+    void setWriter(DiskWriter *writer); // Received data goes to the writer thread instead of memory
+    void setProgress(Progress *progress); // Progress rendering is stopped before the closing message
+    bool writeFiles(bool publish); // Completes writing all received files to disk, or drops them from an atomic batch
+    bool readFile(const char *path, const char *name); // Reads a file from disk to memory, stored under 'name'
+    void releaseData(size_t index); // Frees the data of a file that has been sent
     size_t getFilecount(void);
     size_t getFilesize(void);
 
@@ -231,120 +63,101 @@ class YMODEMSession {
 
   private:
   void readData(size_t length); // reads data from the YMODEM utility
+  bool add(char *name, size_t filesize);
+  ymodem_fileinfo_t &file(size_t index) { return _pages[index / YMODEM_FILETABLE_PAGE][index % YMODEM_FILETABLE_PAGE]; }
 
   size_t _filecount;
-  ymodem_fileinfo_t *files;
+  Arena _arena;                             // names and file table, released with the session
+  std::vector<ymodem_fileinfo_t *> _pages;  // file table, grows a page at a time without moving entries
+  DiskWriter *_writer;
+  Progress *_progress;
 };
 
 const char * YMODEMSession::getFiledata(size_t index) {
   if(index >= _filecount) return NULL;
-  return files[index].buffer;
+  return file(index).buffer;
 }
 
 size_t YMODEMSession::getFilesize(size_t index) {
   if(index >= _filecount) return 0;
 
-  return files[index].filesize;
+  return file(index).filesize;
 }
 
 const char * YMODEMSession::getFilename(size_t index) {
   if(index >= _filecount) return NULL;
 
-  return files[index].filename;
-}
-
-void YMODEMSession::debug(void) {
-  CRC32 crc;
-
-  printf("Current session data:\r\n");
-  for(int i = 0; i < (int)_filecount; i++) {
-    crc.restart();
-    crc.add((const uint8_t*)(files[i].buffer), files[i].filesize);
-    printf("%s (0x%08X) %d bytes\r\n", files[i].filename, crc.calc(), (int)files[i].filesize);
-  }
+  return file(index).filename;
 }
 
 YMODEMSession::YMODEMSession() { 
   _filecount = 0; 
-  files = (ymodem_fileinfo_t *)malloc(YMODEM_MAXFILES * sizeof(ymodem_fileinfo_t));
-  if(!files) throw std::runtime_error("Failed to allocate memory");
+  _writer = NULL;
+  _progress = NULL;
 }
 
+// Names and the file table go with the arena, only file data is freed one by one
 YMODEMSession::~YMODEMSession() {
-  if(!files) return;
-  
-  for(int i = 0; i < (int)_filecount; i++) {
-    free(files[i].buffer);
-    free(files[i].filename);
-  }
-  free(files);
+  for(size_t i = 0; i < _filecount; i++) free(file(i).buffer);
 }
 
 size_t YMODEMSession::getFilecount(void) {
   return _filecount;
 }
 
-bool YMODEMSession::readFiles(int filecount, char **filenames) {
-  ymodem_fileinfo_t &f = files[_filecount];
+bool YMODEMSession::readFile(const char *path, const char *name) {
+  FILE *fp = fopen(path, "rb");
+  if(!fp) { printf("\nError opening \'%s\'\n", path); return false; }
 
-  printf("Reading file(s)...");
+  if(fseek(fp, 0, SEEK_END) != 0) { fclose(fp); return false; }
+  size_t filesize = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  if(!addFile(name, filesize)) { printf("\nMemory allocated error\n"); fclose(fp); return false; }
 
-  for(int n = 0; n < filecount; n++) {
-    FILE *fp = fopen(filenames[n], "rb");
-    if(!fp) { printf("\nError opening \'%s\'\n", filenames[n]); return false; }
+  ymodem_fileinfo_t &f = file(_filecount - 1);
+  if(fread(f.buffer, 1, filesize, fp) != filesize) { printf("\nError reading \'%s\'\n", path); fclose(fp); return false; }
 
-    if(fseek(fp, 0, SEEK_END) != 0) { fclose(fp); return false; }
-    size_t filesize = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-    if(!addFile(basename(filenames[n]), filesize)) { printf("\nMemory allocated error\n"); fclose(fp); return false; }
+  f.received = filesize;
+  fclose(fp);
+  return true;
+}
 
-    if(fread(f.buffer, 1, filesize, fp) != filesize) { printf("\nError reading \'%s\'\n", filenames[n]); fclose(fp); return false; }
+void YMODEMSession::releaseData(size_t index) {
+  if(index >= _filecount) return;
 
-    f.received = filesize;
-    fclose(fp);
-  }
-  printf("\n");
-  return true;
+  free(file(index).buffer);
+  file(index).buffer = NULL;
 }
 
-bool YMODEMSession::writeFiles(void) {
-  if(_filecount == 0) return false;
-  // Check if the last file is done. Delete it from writing if not.
-  if(files[_filecount-1].filesize != files[_filecount-1].received) {
-    _filecount--;
-    free(files[_filecount].buffer);
-    free(files[_filecount].filename);
-  }
-  if(_filecount == 0) return false; // might have deleted the last file previously
-
-
-  switch(_filecount) {
-    case 0: return true;
-    case 1:
-      wipe32chars_restartline();
-      printf("\nWriting file");
-      break;
-    default:
-      wipe32chars_restartline();
-      printf("\nWriting %d files", (int)_filecount);
-  }
+void YMODEMSession::setWriter(DiskWriter *writer) {
+  _writer = writer;
+}
 
-  for(int i = 0; i < (int)_filecount; i++) {
-    ymodem_fileinfo_t &f = files[i];
-  
-    FILE *fp = fopen(f.filename, "wb");
-    if(!fp) { printf("\nError opening \'%s\'\n", f.filename); continue;}
+void YMODEMSession::setProgress(Progress *progress) {
+  _progress = progress;
+}
 
-    if(fwrite(f.buffer, 1, f.filesize, fp) != f.filesize) {
-      printf("\nError writing to \'%s\'\n", f.filename);
-    }
-    fclose(fp);
-  }
-  return true;
+// Drops the last file if it didn't receive all of its data, true if it did
+bool YMODEMSession::checkLastFile(void) {
+  if(!_filecount || (file(_filecount - 1).filesize == file(_filecount - 1).received)) return true;
+
+  if(_writer) _writer->discard();
+  _filecount--;  // its name stays in the arena until the session ends
+  return false;
+}
+
+bool YMODEMSession::writeFiles(bool publish) {
+  if(!_writer) return false;
+  checkLastFile();
+  if(publish) _writer->commit();
+  else _writer->rollback();
+
+  // Wait until everything queued is on disk, the writer keeps the reason of a failure
+  return _writer->flush();
 }
 
 size_t YMODEMSession::getFilesize(void) {
-  return files[_filecount - 1].filesize;
+  return file(_filecount - 1).filesize;
 }
 
 bool YMODEMSession::open(void) {
@@ -353,45 +166,65 @@ bool YMODEMSession::open(void) {
 }
 
 bool YMODEMSession::addFile(const char* dir, const char *filename, size_t filesize) {
-  char *name = (char*)malloc(strlen(dir) + strlen(filename) + 1);
-  strcpy(name, dir);
-  strcat(name, filename);
-  if(!name) return false;
-
-  return(addFile(name, filesize));
+  return add(_arena.join(dir, filename), filesize);
 }
 
 bool YMODEMSession::addFile(const char* filename, size_t filesize) {
-  ymodem_fileinfo_t &f = files[_filecount];
+  return add(_arena.strdup(filename), filesize);
+}
 
-  if(_filecount == YMODEM_MAXFILES) return false;
+// Adds a file under a name allocated from the arena
+bool YMODEMSession::add(char *name, size_t filesize) {
+  if(!name) return false;
+  if(_filecount == _pages.size() * YMODEM_FILETABLE_PAGE) {
+    void *page = _arena.alloc(YMODEM_FILETABLE_PAGE * sizeof(ymodem_fileinfo_t), alignof(ymodem_fileinfo_t));
+    if(!page) return false;
+    _pages.push_back((ymodem_fileinfo_t *)page);
+  }
+  ymodem_fileinfo_t &f = file(_filecount);
 
-  f.buffer = (char *)malloc(filesize);
-  if(f.buffer == NULL) return false;
+  if(_writer) f.buffer = NULL;
+  else {
+    f.buffer = (char *)malloc(filesize);
+    if(f.buffer == NULL) return false;
+  }
   f.bufptr = f.buffer;
 
-  f.filename = (char *)malloc(strlen(filename) + 1);
-  if(f.filename == NULL) {
-    free(f.buffer);
-    return false;
-  }
-  strcpy(f.filename, filename);
+  f.filename = name;
 
   f.filesize = filesize;
   f.received = 0;
 
+  if(_writer) {
+    if(!_writer->open(f.filename, filesize)) {
+      free(f.buffer);
+      return false;
+    }
+    if(filesize == 0) _writer->close();
+  }
+
   _filecount++;
 
   return true;
 }
 
 void YMODEMSession::close(const char *message) {
+  if(_progress) _progress->stop();
   printf("%s", message);
   //vsp->sendKeycodeByte(0, false); // Done
 }
 
 bool YMODEMSession::addData(const uint8_t *data, size_t length) {
-  ymodem_fileinfo_t &f = files[_filecount - 1];
+  ymodem_fileinfo_t &f = file(_filecount - 1);
+
+  if(_writer) {
+    if (length > f.filesize - f.received) return false;
+
+    bool ok = _writer->write(data, length);
+    f.received += length;
+    if(f.received == f.filesize) ok = _writer->close() && ok;
+    return ok;
+  }
 
   size_t used = f.bufptr - f.buffer;
   if (used + length > f.filesize) {
@@ -405,7 +238,7 @@ bool YMODEMSession::addData(const uint8_t *data, size_t length) {
 }
 
 void YMODEMSession::readData(size_t length) {
-  ymodem_fileinfo_t &f = files[_filecount - 1];
+  ymodem_fileinfo_t &f = file(_filecount - 1);
 
   size_t used = f.bufptr - f.buffer;
   if (used + length > f.filesize) {
@@ -419,354 +252,500 @@ void YMODEMSession::readData(size_t length) {
   return;
 }
 
-//---------------------------------------------------------------
-// ymodem_block0 (filename + size) - 128 bytes
-//---------------------------------------------------------------
-static void make_ymodem_block0(uint8_t *buf, const char *filename, uint32_t filesize) {
-    memset(buf, 0, 128);  // clear block
+// Files to send, walked from the command line and read from disk one at a time
+class SendSource : public YMODEMSource {
+  public:
+    SendSource(FileWalker &walker, YMODEMSession &session, Progress &progress, bool quiet)
+        : _walker(walker), _session(session), _progress(progress), _index(0), _quiet(quiet), _started(false), _error(NULL) {}
 
-    size_t pos = 0;
+    bool next(const char **name, uint64_t *size) override;
+    bool read(uint64_t offset, uint8_t *buffer, size_t length) override;
+    void acknowledged(uint64_t offset) override { _progress.update(offset); }
+    void complete(void) override;
+    const char *error(void) override { return _error; }
 
-    // --- Copy filename ---
-    if(filename && filename[0]) {
-        size_t flen = strlen(filename);
-        if(flen > 100) flen = 100;  
-        memcpy(buf + pos, filename, flen);
-        pos += flen;
-    }
-    buf[pos++] = '\0';  // single null terminator after filename
+  private:
+    FileWalker &_walker;
+    YMODEMSession &_session;
+    Progress &_progress;
+    size_t _index;
+    bool _quiet;
+    bool _started;
+    const char *_error;
+};
+
+bool SendSource::next(const char **name, uint64_t *size) {
+  filewalk_entry_t entry;
+
+  if(!_started && !_quiet) {
+    printf("\r\nSending data\r\n\r\n");
+    _started = true;
+  }
+  if(!_walker.next(&entry)) {
+    if(_walker.failed()) _error = "Error reading directories";
+    return false;
+  }
+  if(!_session.readFile(entry.path, entry.name)) {
+    _error = "Error reading file";
+    return false;
+  }
+  _index = _session.getFilecount() - 1;
+  *name = _session.getFilename(_index);
+  *size = _session.getFilesize(_index);
+  _progress.startFile(_index + 1, *name, *size);
+  return true;
+}
 
-    // --- Copy filesize in ASCII ---
-    int n = snprintf((char*)(buf + pos), 128 - pos, "%lu", (unsigned long)filesize);
-    pos += n;
-    buf[pos++] = ' ';  // <--- Python expects a SPACE after filesize, not \0
+bool SendSource::read(uint64_t offset, uint8_t *buffer, size_t length) {
+  const char *data = _session.getFiledata(_index);
 
-    // --- Copy mode in proper octal ---
-    const char *mode = "0600";  // leading 0 = octal
-    size_t mlen = strlen(mode);
-    memcpy(buf + pos, mode, mlen);
-    pos += mlen;
-    buf[pos++] = '\0';  // null terminator after mode
+  if(!data || (offset + length > _session.getFilesize(_index))) return false;
+  memcpy(buffer, data + offset, length);
+  return true;
+}
 
-    // --- Remaining bytes zeroed by memset ---
+void SendSource::complete(void) {
+  _progress.endFile();
+  _session.releaseData(_index);
 }
 
-//---------------------------------------------------------------
-// Send block (128 or 1024 bytes)
-// This only sends HEADER + seqnum + ~seqnum + data + CRC.
-//---------------------------------------------------------------
-static int send_block(uint8_t header, uint8_t block_num, const uint8_t *data, uint16_t data_len, uint16_t block_size) {
-  int p = 0;
+// A batch of one file from memory, a command for an Agon in server mode
+class CommandSource : public YMODEMSource {
+  public:
+    CommandSource(const char *command) : _command(command), _length(strlen(command)), _sent(false) {}
 
-  // --- prepare padded block ---
-  memset(ymodem_tmpbuffer, 0x1A, block_size);           // pad with CTRL-Z
+    bool next(const char **name, uint64_t *size) override;
+    bool read(uint64_t offset, uint8_t *buffer, size_t length) override;
 
-  if (data_len > 0 && data_len <= block_size)
-      memcpy(ymodem_tmpbuffer, data, data_len);         // copy actual data
+  private:
+    const char *_command;
+    size_t _length;
+    bool _sent;
+};
 
+bool CommandSource::next(const char **name, uint64_t *size) {
+  if(_sent) return false;
 
-  // --- compute CRC over full padded block ---
-  CRC16 crc(0x1021);
-  crc.restart();
-  crc.add(ymodem_tmpbuffer, block_size);
-  uint16_t crc_val = crc.calc();
+  _sent = true;
+  *name = YMODEM_COMMAND_NAME;
+  *size = _length;
+  return true;
+}
 
-  // --- send header ---
-  ymodem_fullblockbuffer[p++] = header;       // SOH or STX
-  ymodem_fullblockbuffer[p++] = block_num;
-  ymodem_fullblockbuffer[p++] = 255 - block_num;
+bool CommandSource::read(uint64_t offset, uint8_t *buffer, size_t length) {
+  if(offset + length > _length) return false;
+  memcpy(buffer, _command + offset, length);
+  return true;
+}
 
-  // --- send data ---
-  memcpy(&ymodem_fullblockbuffer[p], ymodem_tmpbuffer, block_size);
-  p += block_size;
+// Received files, handed to the disk writer
+class ReceiveSink : public YMODEMSink {
+  public:
+    ReceiveSink(const char *dir, YMODEMSession &session, DiskWriter &writer, Progress &progress)
+        : _dir(dir), _session(session), _writer(writer), _progress(progress), _received(0), _short(false) {}
 
-  // --- send CRC16 ---
-  ymodem_fullblockbuffer[p++] = (crc_val >> 8) & 0xFF;  // high byte
-  ymodem_fullblockbuffer[p++] = crc_val & 0xFF;         // low byte
+    bool open(const char *name, uint64_t size) override;
+    bool write(const uint8_t *data, size_t length) override;
+    bool close(void) override;
+    bool finish(bool complete) override { return _session.writeFiles(complete); }
+    const char *error(void) override;
 
-  return io_write(ymodem_fullblockbuffer, p);
+  private:
+    const char *_dir;
+    YMODEMSession &_session;
+    DiskWriter &_writer;
+    Progress &_progress;
+    uint64_t _received;
+    bool _short;            // a file ended before its announced size
+};
+
+bool ReceiveSink::open(const char *name, uint64_t size) {
+  if(!_session.addFile(_dir, name, size)) return false;
+
+  _received = 0;
+  _progress.startFile((unsigned int)_session.getFilecount(), name, size);
+  return true;
 }
 
-void ymodem_send_cpp(int port, int filecount, char **filenames) {
-  YMODEMSession session;
-  uint8_t rx;
-  uint32_t offset;
-  uint8_t blocknumber;
-  int retry;
-  bool startup = true;
+bool ReceiveSink::write(const uint8_t *data, size_t length) {
+  if(!_session.addData(data, length)) return false;
 
-  serial_port = port;
+  _received += length;
+  _progress.update(_received);
+  return true;
+}
 
-  ymodem_session_aborted = 0;
+// A file short of its announced size is dropped, the writer would keep it open otherwise
+bool ReceiveSink::close(void) {
+  _progress.endFile();
+  if(!_session.checkLastFile()) {
+    _short = true;
+    return false;
+  }
+  return !_writer.failed();
+}
 
-  if (!session.open()) return;
+const char *ReceiveSink::error(void) {
+  if(_writer.failed()) return _writer.error();
+  return _short ? "File shorter than announced" : NULL;
+}
 
-  if (!session.readFiles(filecount, filenames)) { session.close("\r\n"); return; }
+// Everything a transfer uses besides the engine, one per port. Nothing is shared
+// between transfers, so transfers on different ports can run on their own threads.
+struct ymodem_transfer {
+  int port;
+  ymodem_options_t options;
+  uint8_t buffer[YMODEM_RX_BUFFER];
+  char error[YMODEM_ERROR_LENGTH];
+};
 
-  uart_flush();
-  printf("Waiting for receiver\n");
+// Eat all uart RX during a specific time period
+static void uart_flush(ymodem_transfer_t *transfer) {
+  uint64_t timeReceived = millis();
 
-  // --- Wait for initial 'C' ---
-  while(1) {
-    if(serialRx_byte_t(&rx, 100) && rx == YMODEM_DEFCRC16) break;
+  while(millis() - timeReceived < YMODEM_FLUSHTIME) {
+    [[maybe_unused]] auto _ = read(transfer->port, transfer->buffer, sizeof(transfer->buffer));
   }
-  printf("\r\nSending data\r\n\r\n");
-
-  for (int filecounter = 0; filecounter < (int)session.getFilecount(); filecounter++) {
-    const char* filename = session.getFilename(filecounter);
-    uint32_t filesize = session.getFilesize(filecounter);
-    wipe32chars_restartline();
-    printf("%d - %s\r\n", filecounter+1, filename);
-
-    // --- Wait for 'C' to start subsequent block 0
-    if(!startup) {
-      for (retry = 0; retry < YMODEM_MAX_RETRY; retry++) {
-          if (serialRx_byte_t(&rx, YMODEM_TIMEOUT) && rx == YMODEM_DEFCRC16) break;
-      }
-      if (retry >= YMODEM_MAX_RETRY) { session.close("\r\nMax retries\r\n"); return; }
-    }
-    else startup = false;
-
-    // --- Send ymodem_block0 ---
-    make_ymodem_block0(ymodem_block0, filename, filesize);
-    for (retry = 0; retry < YMODEM_MAX_RETRY; retry++) {
-        send_block(YMODEM_SOH, 0, ymodem_block0, 128, 128);
-        if (serialRx_byte_t(&rx, YMODEM_TIMEOUT)) {
-            if (rx == YMODEM_ACK) break;
-            if (rx == YMODEM_CAN) { session.close("\r\nReceiver aborts\r\n"); return; }
-        }
-    }
-    if (retry >= YMODEM_MAX_RETRY) { session.close("\r\nMax retries\r\n"); return; }
+  return;
+}
 
-    // --- Wait for 'C' to start data blocks ---
-    for (retry = 0; retry < YMODEM_MAX_RETRY; retry++) {
-        if (serialRx_byte_t(&rx, YMODEM_TIMEOUT) && rx == YMODEM_DEFCRC16) break;
-    }
-    if (retry >= YMODEM_MAX_RETRY) { session.close("\r\nMax retries\r\n"); return; }
-
-    // --- Send file data ---
-    // First send as many 1K (STX) blocks as possible.
-    // Then send the remainder in 128-byte (SOH) blocks as older clients like rz expect.
-    offset = 0;
-    blocknumber = 1;
-
-    // --- Send full 1K STX blocks ---
-    while ((filesize - offset) >= YMODEM_BLOCKSIZE_1K) {
-        for (retry = 0; retry < YMODEM_MAX_RETRY; retry++) {
-            send_block(YMODEM_STX,
-                      blocknumber,
-                      (uint8_t *)session.getFiledata(filecounter) + offset,
-                      YMODEM_BLOCKSIZE_1K,
-                      YMODEM_BLOCKSIZE_1K);
-
-            if (serialRx_byte_t(&rx, YMODEM_TIMEOUT)) {
-                if (rx == YMODEM_ACK) {
-                    offset += YMODEM_BLOCKSIZE_1K;
-                    blocknumber++;
-                    break;
-                }
-                if (rx == YMODEM_CAN) {
-                    session.close("Receiver aborts\r\n");
-                    return;
-                }
-            }
-        }
-        if (retry >= YMODEM_MAX_RETRY) {
-            session.close("\r\nMax retries\r\n");
-            return;
-        }
-        printf("\r%d/%d", offset, filesize);
-        fflush(stdout);
+// Runs the protocol engine on the serial port until the session ends. Output is written
+// as the port takes it, so input such as a cancel is seen while a stream of blocks goes out.
+static bool run_session(ymodem_transfer_t *transfer, YMODEMEngine &engine) {
+  struct pollfd pfd = {transfer->port, POLLIN, 0};
+  const uint8_t *data;
+  size_t length;
+
+  engine.start(nanos());
+  while(1) {
+    // Also sends the cancel sequence queued by a failing session
+    length = engine.output(&data);
+    if((length == 0) && (engine.status() != YMODEM_RUNNING)) break;
+
+    int timeout = -1;
+    uint64_t now = nanos();
+    uint64_t deadline = engine.deadline();
+    if(deadline != YMODEM_NO_DEADLINE) timeout = (deadline > now) ? (int)((deadline - now + 999999) / 1000000) : 0;
+
+    pfd.events = POLLIN | ((length > 0) ? POLLOUT : 0);
+    int ready = poll(&pfd, 1, timeout);
+    if(((ready < 0) && (errno != EINTR)) || ((ready > 0) && (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)))) {
+      snprintf(transfer->error, sizeof(transfer->error), "Serial port error");
+      return false;
     }
-    // --- Send remainder using 128-byte SOH blocks ---
-    uint32_t remaining = filesize - offset;
-    while (remaining > 0) {
-        uint16_t chunk = (remaining > YMODEM_BLOCKSIZE_128)
-                            ? YMODEM_BLOCKSIZE_128
-                            : remaining;
-
-        for (retry = 0; retry < YMODEM_MAX_RETRY; retry++) {
-            send_block(YMODEM_SOH,
-                      blocknumber,
-                      (uint8_t *)session.getFiledata(filecounter) + offset,
-                      chunk,                     // actual data length
-                      YMODEM_BLOCKSIZE_128);    // pad to 128 bytes
-
-            if (serialRx_byte_t(&rx, YMODEM_TIMEOUT)) {
-                if (rx == YMODEM_ACK) {
-                    offset += chunk;
-                    remaining -= chunk;
-                    blocknumber++;
-                    break;
-                }
-                if (rx == YMODEM_CAN) {
-                    session.close("Receiver aborts\r\n");
-                    return;
-                }
-            }
-        }
-        if (retry >= YMODEM_MAX_RETRY) {
-            session.close("\r\nMax retries\r\n");
-            return;
-        }
-        printf("\r%d/%d", offset, filesize);
-        fflush(stdout);
+    if((ready > 0) && (pfd.revents & POLLIN)) {
+      ssize_t n = read(transfer->port, transfer->buffer, sizeof(transfer->buffer));
+      if(n > 0) engine.receive(transfer->buffer, n, nanos());
     }
-
-    // --- Send EOT ---
-    uint8_t eot = YMODEM_EOT;
-    for (retry = 0; retry < YMODEM_MAX_RETRY; retry++) {
-        io_write(&eot, 1);
-        if (serialRx_byte_t(&rx, YMODEM_TIMEOUT) && rx == YMODEM_ACK) break;
+    if((ready > 0) && (pfd.revents & POLLOUT) && ((length = engine.output(&data)) > 0)) {
+      ssize_t n = write(transfer->port, data, length);
+      if((n < 0) && (errno != EINTR) && (errno != EAGAIN)) {
+        snprintf(transfer->error, sizeof(transfer->error), "Serial port error");
+        return false;
+      }
+      if(n > 0) engine.sent(n, nanos());
     }
-    if (retry >= YMODEM_MAX_RETRY) { session.close("\r\nMax retries\r\n"); return; }  
+    engine.poll(nanos());
   }
-
-  // --- Wait for final 'C' for ymodem_block0
-  for (retry = 0; retry < YMODEM_MAX_RETRY; retry++) {
-      if (serialRx_byte_t(&rx, YMODEM_TIMEOUT) && rx == YMODEM_DEFCRC16) break;
-  }
-  if (retry >= YMODEM_MAX_RETRY) { session.close("\r\nMax retries\r\n"); return; }
-  
-  // --- Send final empty ymodem_block0 safely ---
-  memset(ymodem_block0, 0, sizeof(ymodem_block0));
-  for (retry = 0; retry < YMODEM_MAX_RETRY; retry++) {
-      send_block(YMODEM_SOH, 0, ymodem_block0, 128, 128);  // send at least 1 zero byte
-      if (serialRx_byte_t(&rx, YMODEM_TIMEOUT) && rx == YMODEM_ACK) break;
+  if(engine.status() == YMODEM_FAILED) {
+    snprintf(transfer->error, sizeof(transfer->error), "%s", engine.error());
+    return false;
   }
-  
-  wipe32chars_restartline();
-  session.close("\r\nDone\r\n");
+  return true;
 }
 
-extern "C" {
+static bool ymodem_send_cpp(ymodem_transfer_t *transfer, int filecount, char **filenames) {
+  TransferStats stats(transfer->options.stats_path, "send", transfer->options.baudrate);
+  Progress progress(transfer->options.quiet);
+  YMODEMSession session;
+  char message[YMODEM_ERROR_LENGTH + 8];
 
-void ymodem_send(int port, int filecount, char ** filenames) {
-    ymodem_send_cpp(port, filecount, filenames);
+  if (!session.open()) return false;
+  session.setProgress(&progress);
+
+  // Start walking the files/directories, this continues while earlier files are sent
+  FileWalker walker(filecount, filenames, transfer->options.recursive, transfer->options.root);
+  SendSource source(walker, session, progress, transfer->options.quiet);
+  YMODEMSender sender(source, &stats);
+
+  if(!transfer->options.quiet) printf("Waiting for receiver\n");
+  if(!run_session(transfer, sender)) {
+    snprintf(message, sizeof(message), "\r\n%s\r\n", transfer->error);
+    session.close(message);
+    return false;
+  }
+  session.close(transfer->options.quiet ? "" : "\r\nDone\r\n");
+  return true;
 }
 
-} // extern "C"
+static bool ymodem_receive_cpp(ymodem_transfer_t *transfer, const char *dir) {
+  TransferStats stats(transfer->options.stats_path, "receive", transfer->options.baudrate);
+  DiskWriter writer(transfer->options.atomic);
+  Progress progress(transfer->options.quiet);
+  YMODEMSession session;
 
+  if(!transfer->options.quiet) printf("Receiving data\r\n\r\n");
 
+  if(!session.open()) return false;
+  session.setWriter(&writer);
+  session.setProgress(&progress);
 
-void ymodem_receive_cpp(int port, const char *dir) {
-  YMODEMSession session;
-  bool session_done;
-  bool receiving_data;
-  size_t errors,timeout_counter;
-  size_t offset,write_len;
-  uint8_t blocknumber;
-  uint8_t cancel_counter;
-  ymodem_block_t block;
-
-  serial_port = port;
-
-  uart_flush();
-  printf("Receiving data\r\n\r\n");
-
-  errors = 0;
-  cancel_counter = 0;
-  timeout_counter = 0;
-  ymodem_session_aborted = false;
-  session_done = false;
-  receiving_data = false;
-  blocknumber = 0;
-  offset = 0;
-
-  if(!session.open()) return;
-
-  send_reqcrc();
-
-  while(!session_done && !ymodem_session_aborted) {
-    get_block(&block, blocknumber);
-    if(block.length == 0) {
-      if(blocknumber && (++timeout_counter > (YMODEM_MAX_RETRY))) {
-        printf("\r\nTimeout\r\n");
-        ymodem_session_aborted = true;
+  ReceiveSink sink(dir, session, writer, progress);
+  YMODEMReceiver receiver(sink, &stats, transfer->options.baudrate, transfer->options.streaming);
+
+  bool ok = run_session(transfer, receiver);
+  if(!ok) {
+    progress.stop();
+    printf("\r\n%s\r\n", transfer->error);
+    // A failing engine has dropped the files itself, after a port error they are still pending
+    if(receiver.status() == YMODEM_RUNNING) session.writeFiles(false);
+  }
+  session.close(transfer->options.quiet ? "" : "\r\nDone\r\n");
+  uart_flush(transfer);
+  return ok;
+}
+
+// Reads and removes a reply file of the Agon server
+static bool read_reply(const char *dir, const char *name, std::vector<uint8_t> &data) {
+  std::string path = std::string(dir) + name;
+  FILE *f = fopen(path.c_str(), "rb");
+  uint8_t buffer[4096];
+  size_t n;
+
+  if(!f) return false;
+  while((n = fread(buffer, 1, sizeof(buffer), f)) > 0) data.insert(data.end(), buffer, buffer + n);
+  fclose(f);
+  unlink(path.c_str());
+  return true;
+}
+
+static uint32_t get_uint32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Prints a binary directory listing, a line per entry: size, FAT attributes, CRC32 if listed, name
+static bool print_listing(const std::vector<uint8_t> &data) {
+  if(data.empty()) return false;
+
+  bool withcrc = data[0] & YMODEM_LIST_CRC;
+  size_t fixed = 4 + 1 + (withcrc ? 4 : 0) + 1;
+  size_t offset = 1;
+  while(offset + fixed <= data.size()) {
+    const uint8_t *record = &data[offset];
+    size_t namelength = record[fixed - 1];
+    if(offset + fixed + namelength > data.size()) break;
+    offset += fixed + namelength;
+    if(namelength == 0) continue;  // padding, for entries removed while the listing was made
+
+    uint8_t attrib = record[4];
+    char flags[6] = {
+      (char)((attrib & 0x10) ? 'd' : '-'),
+      (char)((attrib & 0x01) ? 'r' : '-'),
+      (char)((attrib & 0x02) ? 'h' : '-'),
+      (char)((attrib & 0x04) ? 's' : '-'),
+      (char)((attrib & 0x20) ? 'a' : '-'), 0};
+    printf("%10u %s ", get_uint32(record), flags);
+    if(withcrc) {
+      if(attrib & 0x10) printf("         ");
+      else printf("%08X ", get_uint32(record + 5));
+    }
+    printf("%.*s%s\n", (int)namelength, (const char *)record + fixed, (attrib & 0x10) ? "/" : "");
+  }
+  return true;
+}
+
+static const char *mos_error(uint8_t code) {
+  switch(code) {
+    case 4: return "file not found";
+    case 5: return "path not found";
+    case 6: return "invalid name";
+    case 7: return "access denied or directory full";
+    case 8: return "access denied, or already exists";
+    case 10: return "write protected";
+    case YMODEM_BAD_OPERATION: return "unknown operation";
+    default: return "error";
+  }
+}
+
+// Prints the result of each operation line of 'command', false if any failed
+static bool print_results(const char *command, const std::vector<uint8_t> &results) {
+  size_t index = 0;
+  bool ok = true;
+
+  for(const char *line = command; *line; ) {
+    size_t length = strcspn(line, "\n");
+    char first = line[strspn(line, " \t\r")];
+    if((first != '\n') && (first != 0)) {  // the server skips empty lines
+      if(index < results.size()) {
+        uint8_t result = results[index];
+        if(result == 0) printf("%.*s: ok\n", (int)length, line);
+        else printf("%.*s: %s (%u)\n", (int)length, line, mos_error(result), result);
+        ok = ok && (result == 0);
       }
-      else send_reqcrc();
-      continue;
+      else {
+        printf("%.*s: not run\n", (int)length, line);
+        ok = false;
+      }
+      index++;
     }
+    line += length;
+    if(*line) line++;
+  }
+  return ok;
+}
+
+// Sends a command to an Agon in server mode. Commands that make the Agon send
+// ('send', 'list', filesystem operations) are followed by a receive to 'dir';
+// listings and results are printed and not kept.
+static bool ymodem_command_cpp(ymodem_transfer_t *transfer, const char *command, const char *dir) {
+  TransferStats stats(NULL, "send", transfer->options.baudrate);
+  CommandSource source(command);
+  YMODEMSender sender(source, &stats);
+  std::vector<uint8_t> reply;
+  char word[8];
+
+  if(strlen(command) > YMODEM_COMMAND_LENGTH) {
+    snprintf(transfer->error, sizeof(transfer->error), "Command too long");
+    printf("%s\n", transfer->error);
+    return false;
+  }
+  if(!transfer->options.quiet) printf("Waiting for receiver\n");
+  if(!run_session(transfer, sender)) {
+    printf("%s\n", transfer->error);
+    return false;
+  }
 
-    timeout_counter = 0;
-    if(block.blocktype != YMODEM_CAN) cancel_counter = 0;
-
-    switch(block.blocktype) {
-      case YMODEM_SOH:
-      case YMODEM_STX:
-        // Check for 'empty' block 0 block, might be early timed out
-        if(block.end_of_batch) {
-          session_done = true;
-          send_ack();
-          break;
-        }
-        // Check for corrupted, smaller than required blocks
-        if(block.timed_out) {
-          errors++;
-          break;
-        }
-        if(block.crc_verified && (block.correct_blocknumber)) {
-          send_ack();
-          if((!receiving_data) && (block.blocknumber == 0)) {
-            // Header block
-            if(!session.addFile(dir, block.filename, block.filesize)) {
-              printf("\r\nError allocating memory\r\n");
-              ymodem_session_aborted = true;
-            }
-            wipe32chars_restartline();
-            printf("%d - %s\r\n", (int)session.getFilecount(), block.filename);
-            send_reqcrc();
-            receiving_data = true;
-            offset = 0;
-          }
-          else {
-            // Data block
-            offset += block.length - YMODEM_BLOCK_OVERHEAD;  // total bytes received
-            if (offset > session.getFilesize()) {
-              write_len = block.length - YMODEM_BLOCK_OVERHEAD - (offset - session.getFilesize());
-              offset = session.getFilesize();
-            }
-            else write_len = block.length - YMODEM_BLOCK_OVERHEAD;
-            session.addData(block.data + YMODEM_BLOCK_HEADER, write_len);
-            printf("\r%d/%d", (int)offset, (int)session.getFilesize());
-            fflush(stdout);
-          }
-          blocknumber++;
-        }
-        else send_nak();
-        break;
-      case YMODEM_EOT:
-        send_ack();
-        receiving_data = false;
-        blocknumber = 0;
-        offset = 0;
-        send_reqcrc();
-        break;
-      case YMODEM_CAN:
-        if(++cancel_counter > 1) {
-          printf("\r\nRemote abort\r\n");
-          ymodem_session_aborted = true;
-        }
-        break;
-      default:
-        errors++;
+  if(sscanf(command, " %7s", word) != 1) return true;
+  bool list = (strcmp(word, "list") == 0);
+  bool operations = (strcmp(word, "rm") == 0) || (strcmp(word, "mkdir") == 0) || (strcmp(word, "mv") == 0);
+  if(!list && !operations && (strcmp(word, "send") != 0)) return true;
+
+  bool quiet = transfer->options.quiet;
+  if(list || operations) transfer->options.quiet = true;
+  bool ok = ymodem_receive_cpp(transfer, dir);
+  transfer->options.quiet = quiet;
+  if(!list && !operations) return ok;
+
+  if(!read_reply(dir, list ? YMODEM_LISTING_NAME : YMODEM_RESULT_NAME, reply)) {
+    printf(list ? "Directory not found\n" : "No reply\n");  // the server sends an empty batch
+    return false;
+  }
+  if(list) return print_listing(reply) && ok;
+  return print_results(command, reply) && ok;
+}
+
+// Checksums the files a send of the same arguments would transfer, a batch of files at a time
+static bool ymodem_checksum_cpp(int filecount, char **filenames, const ymodem_options_t *options) {
+  FileWalker walker(filecount, filenames, options->recursive);
+  ParallelChecksum checksum;
+  std::vector<filewalk_entry_t> entries(FILEWALK_QUEUE_LENGTH);
+  std::vector<checksum_file_t> list(FILEWALK_QUEUE_LENGTH);
+  bool ok = true;
+  bool more = true;
+
+  while(more) {
+    size_t count = 0;
+    while((count < entries.size()) && (more = walker.next(&entries[count]))) {
+      list[count].path = entries[count].path;
+      count++;
     }
-    if(errors > YMODEM_MAX_ERRORS) {
-      printf("\r\nMax errors\r\n");
-      ymodem_session_aborted = true;
+    checksum.files(list.data(), count);
+
+    for(size_t i = 0; i < count; i++) {
+      if(!list[i].ok) {
+        printf("Error reading \'%s\'\n", entries[i].path);
+        ok = false;
+        continue;
+      }
+      printf("%08X %10llu %s\n", list[i].crc, (unsigned long long)list[i].size, entries[i].name);
     }
   }
-  if(ymodem_session_aborted) send_abort();
-  session.writeFiles();
-  session.close("\r\nDone\r\n");
-  uart_flush();
+  if(walker.failed()) {
+    printf("Error reading directories\n");
+    ok = false;
+  }
+  return ok;
 }
 
 extern "C" {
 
-void ymodem_receive(int port, const char *dir) {
-    ymodem_receive_cpp(port, dir);
+ymodem_transfer_t *ymodem_transfer_open(int port, const ymodem_options_t *options) {
+  ymodem_transfer_t *transfer = (ymodem_transfer_t *)malloc(sizeof(ymodem_transfer_t));
+  if(!transfer) return NULL;
+
+  transfer->port = port;
+  transfer->options = *options;
+  transfer->error[0] = 0;
+  return transfer;
 }
 
-} // extern "C"
+void ymodem_transfer_close(ymodem_transfer_t *transfer) {
+  free(transfer);
+}
+
+const char *ymodem_transfer_error(ymodem_transfer_t *transfer) {
+  return transfer->error;
+}
+
+bool ymodem_transfer_send(ymodem_transfer_t *transfer, int filecount, char **filenames) {
+  transfer->error[0] = 0;
+  try {
+    return ymodem_send_cpp(transfer, filecount, filenames);
+  }
+  catch(const std::exception &e) {
+    snprintf(transfer->error, sizeof(transfer->error), "%s", e.what());
+    return false;
+  }
+}
+
+bool ymodem_transfer_receive(ymodem_transfer_t *transfer, const char *dir) {
+  transfer->error[0] = 0;
+  try {
+    return ymodem_receive_cpp(transfer, dir);
+  }
+  catch(const std::exception &e) {
+    snprintf(transfer->error, sizeof(transfer->error), "%s", e.what());
+    return false;
+  }
+}
+
+bool ymodem_send(int port, int filecount, char ** filenames, const ymodem_options_t *options) {
+  ymodem_transfer_t *transfer = ymodem_transfer_open(port, options);
+  if(!transfer) return false;
+
+  bool ok = ymodem_transfer_send(transfer, filecount, filenames);
+  ymodem_transfer_close(transfer);
+  return ok;
+}
+
+bool ymodem_transfer_command(ymodem_transfer_t *transfer, const char *command, const char *dir) {
+  transfer->error[0] = 0;
+  try {
+    return ymodem_command_cpp(transfer, command, dir);
+  }
+  catch(const std::exception &e) {
+    snprintf(transfer->error, sizeof(transfer->error), "%s", e.what());
+    return false;
+  }
+}
+
+bool ymodem_receive(int port, const char *dir, const ymodem_options_t *options) {
+  ymodem_transfer_t *transfer = ymodem_transfer_open(port, options);
+  if(!transfer) return false;
+
+  bool ok = ymodem_transfer_receive(transfer, dir);
+  ymodem_transfer_close(transfer);
+  return ok;
+}
 
+bool ymodem_checksum(int filecount, char **filenames, const ymodem_options_t *options) {
+  try {
+    return ymodem_checksum_cpp(filecount, filenames, options);
+  }
+  catch(const std::exception &e) {
+    printf("%s\n", e.what());
+    return false;
+  }
+}
+
+} // extern "C"
@@ -1,11 +1,37 @@
 #pragma once
 
+#include <stdbool.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-void ymodem_send(int port, int filecount, char **filenames);
-void ymodem_receive(int port, const char *dir);
+typedef struct {
+  bool recursive;           // send directories recursively, names relative to the given directory
+  bool atomic;              // receive to temporary files, published together when the batch completes
+  bool quiet;               // no progress or status output, only errors
+  bool streaming;           // receive with YMODEM-g, blocks are not acknowledged; needs an error free, flow controlled link
+  const char *stats_path;   // write JSON transfer statistics to this file, if not NULL
+  const char *root;         // send: file arguments are relative to this directory and sent under that relative name, if not NULL
+  int baudrate;             // line speed of the serial port
+} ymodem_options_t;
+
+// Per-port transfer context. Transfers on different contexts share no state and may run concurrently.
+typedef struct ymodem_transfer ymodem_transfer_t;
+
+ymodem_transfer_t *ymodem_transfer_open(int port, const ymodem_options_t *options);
+void ymodem_transfer_close(ymodem_transfer_t *transfer);
+bool ymodem_transfer_send(ymodem_transfer_t *transfer, int filecount, char **filenames);
+bool ymodem_transfer_receive(ymodem_transfer_t *transfer, const char *dir);
+bool ymodem_transfer_command(ymodem_transfer_t *transfer, const char *command, const char *dir);  // to 'ymodem -d' on the Agon
+const char *ymodem_transfer_error(ymodem_transfer_t *transfer);  // reason the last transfer failed
+
+// Single transfer on a temporary context
+bool ymodem_send(int port, int filecount, char **filenames, const ymodem_options_t *options);
+bool ymodem_receive(int port, const char *dir, const ymodem_options_t *options);
+
+// Prints the CRC32 and size of each file a send of the same arguments would transfer, without a serial port
+bool ymodem_checksum(int filecount, char **filenames, const ymodem_options_t *options);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,753 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Crc.h"
+#include "probes.h"
+#include "ymodem_engine.h"
+
+#define NS_PER_MS                      1000000ULL
+
+static YMODEMStats no_stats;
+
+//---------------------------------------------------------------
+// Common engine, output queue and session status
+//---------------------------------------------------------------
+YMODEMEngine::YMODEMEngine(YMODEMStats *stats)
+    : _stats(stats ? *stats : no_stats),
+      _deadline(YMODEM_NO_DEADLINE),
+      _sent_ns(0),
+      _last_ns(0),
+      _status(YMODEM_RUNNING),
+      _output_length(0),
+      _output_offset(0)
+{
+  _error[0] = 0;
+}
+
+size_t YMODEMEngine::output(const uint8_t **data) {
+  *data = _output + _output_offset;
+  return _output_length - _output_offset;
+}
+
+void YMODEMEngine::sent(size_t length, uint64_t now_ns) {
+  if(length > _output_length - _output_offset) length = _output_length - _output_offset;
+
+  _output_offset += length;
+  if(_output_offset == _output_length) _output_offset = _output_length = 0;
+  _stats.tx(length);
+  _sent_ns = now_ns;
+  _last_ns = now_ns;
+  refill(now_ns);
+}
+
+bool YMODEMEngine::output_room(size_t length) {
+  return (_output_length - _output_offset + length) <= sizeof(_output);
+}
+
+void YMODEMEngine::queue(const uint8_t *data, size_t length) {
+  // Move unsent output to the front, a frame may be queued while a short write is pending
+  if(_output_length + length > sizeof(_output)) {
+    memmove(_output, _output + _output_offset, _output_length - _output_offset);
+    _output_length -= _output_offset;
+    _output_offset = 0;
+  }
+  if(_output_length + length > sizeof(_output)) {
+    fail("Output overflow");
+    return;
+  }
+  memcpy(_output + _output_length, data, length);
+  _output_length += length;
+}
+
+void YMODEMEngine::queue(uint8_t c) {
+  queue(&c, 1);
+}
+
+void YMODEMEngine::abort(void) {
+  uint8_t c[] = {YMODEM_CAN, YMODEM_CAN};
+  queue(c, sizeof(c));
+}
+
+void YMODEMEngine::fail(const char *format, ...) {
+  va_list args;
+
+  // Keep the first reason
+  if(_status == YMODEM_FAILED) return;
+
+  va_start(args, format);
+  vsnprintf(_error, sizeof(_error), format, args);
+  va_end(args);
+  _status = YMODEM_FAILED;
+  _deadline = YMODEM_NO_DEADLINE;
+}
+
+void YMODEMEngine::done(void) {
+  _status = YMODEM_DONE;
+  _deadline = YMODEM_NO_DEADLINE;
+}
+
+// Received data ends a period of waiting on the line
+void YMODEMEngine::activity(uint64_t now_ns) {
+  if(_last_ns && (now_ns > _last_ns)) _stats.idle(now_ns - _last_ns);
+  _last_ns = now_ns;
+}
+
+static uint16_t block_crc(const uint8_t *data, size_t length, YMODEMStats &stats) {
+  stats.startCrc();
+  uint16_t result = Crc16Xmodem::compute(data, length); // Ymodem uses CRC-16-CCITT polynomial
+  stats.endCrc();
+  return result;
+}
+
+//---------------------------------------------------------------
+// ymodem_block0 (filename + size) - 128 bytes
+//---------------------------------------------------------------
+static void make_ymodem_block0(uint8_t *buf, const char *filename, uint64_t filesize) {
+    memset(buf, 0, 128);  // clear block
+
+    size_t pos = 0;
+
+    // --- Copy filename ---
+    if(filename && filename[0]) {
+        size_t flen = strlen(filename);
+        if(flen > YMODEM_MAX_NAME_LENGTH) flen = YMODEM_MAX_NAME_LENGTH;
+        memcpy(buf + pos, filename, flen);
+        pos += flen;
+    }
+    buf[pos++] = '\0';  // single null terminator after filename
+
+    // --- Copy filesize in ASCII ---
+    int n = snprintf((char*)(buf + pos), 128 - pos, "%llu", (unsigned long long)filesize);
+    pos += n;
+    buf[pos++] = ' ';  // <--- Python expects a SPACE after filesize, not \0
+
+    // --- Copy mode in proper octal ---
+    const char *mode = "0600";  // leading 0 = octal
+    size_t mlen = strlen(mode);
+    memcpy(buf + pos, mode, mlen);
+    pos += mlen;
+    buf[pos++] = '\0';  // null terminator after mode
+
+    // --- Remaining bytes zeroed by memset ---
+}
+
+//---------------------------------------------------------------
+// Sender
+//---------------------------------------------------------------
+YMODEMSender::YMODEMSender(YMODEMSource &source, YMODEMStats *stats)
+    : YMODEMEngine(stats),
+      _source(source),
+      _state(FLUSH),
+      _streaming(false),
+      _retry(0),
+      _filesize(0),
+      _offset(0),
+      _blocknumber(0),
+      _frame_length(0),
+      _frame_payload(0)
+{
+}
+
+void YMODEMSender::start(uint64_t now_ns) {
+  _state = FLUSH;
+  _deadline = now_ns + YMODEM_FLUSHTIME * NS_PER_MS;
+  _last_ns = now_ns;
+}
+
+void YMODEMSender::send_frame(void) {
+  queue(_frame, _frame_length);
+  if(_frame[0] != YMODEM_EOT) {
+    _stats.block();
+    YMODEM_PROBE3(block_send, _frame[0], _frame[YMODEM_BLOCK_SEQ_INDEX], _frame_length - YMODEM_BLOCK_OVERHEAD);
+  }
+}
+
+// Header block of the next file, or the empty header block that ends the batch
+void YMODEMSender::send_header(uint64_t now_ns) {
+  const char *name;
+  uint64_t size;
+
+  _frame[0] = YMODEM_SOH;
+  _frame[YMODEM_BLOCK_SEQ_INDEX] = 0;
+  _frame[YMODEM_BLOCK_SEQ_COMP_INDEX] = 255;
+  if(_source.next(&name, &size)) {
+    make_ymodem_block0(&_frame[YMODEM_BLOCK_HEADER], name, size);
+    _stats.startFile(name, size);
+    _filesize = size;
+    _state = HEADER_ACK;
+  }
+  else {
+    if(_source.error()) {
+      abort();
+      fail("Send aborted");
+      return;
+    }
+    memset(&_frame[YMODEM_BLOCK_HEADER], 0, YMODEM_BLOCKSIZE_128);
+    _state = FINAL_ACK;
+  }
+  uint16_t crc = block_crc(&_frame[YMODEM_BLOCK_HEADER], YMODEM_BLOCKSIZE_128, _stats);
+  _frame[YMODEM_BLOCK_HEADER + YMODEM_BLOCKSIZE_128] = (crc >> 8) & 0xFF;
+  _frame[YMODEM_BLOCK_HEADER + YMODEM_BLOCKSIZE_128 + 1] = crc & 0xFF;
+  _frame_length = YMODEM_BLOCKSIZE_128 + YMODEM_BLOCK_OVERHEAD;
+  _frame_payload = 0;
+
+  _retry = 0;
+  send_frame();
+  _deadline = now_ns + YMODEM_TIMEOUT * NS_PER_MS;
+
+  // YMODEM-g doesn't ACK header blocks, the receiver asks for the data right away
+  if(_streaming) {
+    if(_state == FINAL_ACK) done();
+    else {
+      _state = WAIT_DATA;
+      _deadline = now_ns + YMODEM_TIMEOUT * NS_PER_MS;
+    }
+  }
+}
+
+// Next data block; as many 1K (STX) blocks as possible, then the remainder
+// in 128-byte (SOH) blocks as older clients like rz expect. EOT after the last block.
+void YMODEMSender::send_data(uint64_t now_ns) {
+  uint64_t remaining = _filesize - _offset;
+  size_t block_size;
+
+  if(remaining == 0) {
+    _frame[0] = YMODEM_EOT;
+    _frame_length = 1;
+    _state = EOT_ACK;
+  }
+  else {
+    if(remaining >= YMODEM_BLOCKSIZE_1K) {
+      _frame[0] = YMODEM_STX;
+      block_size = YMODEM_BLOCKSIZE_1K;
+      _frame_payload = YMODEM_BLOCKSIZE_1K;
+    }
+    else {
+      _frame[0] = YMODEM_SOH;
+      block_size = YMODEM_BLOCKSIZE_128;
+      _frame_payload = (remaining > YMODEM_BLOCKSIZE_128) ? YMODEM_BLOCKSIZE_128 : remaining;
+    }
+    _frame[YMODEM_BLOCK_SEQ_INDEX] = _blocknumber;
+    _frame[YMODEM_BLOCK_SEQ_COMP_INDEX] = 255 - _blocknumber;
+    if(!_source.read(_offset, &_frame[YMODEM_BLOCK_HEADER], _frame_payload)) {
+      abort();
+      fail("Send aborted");
+      return;
+    }
+    memset(&_frame[YMODEM_BLOCK_HEADER + _frame_payload], 0x1A, block_size - _frame_payload);  // pad with CTRL-Z
+
+    uint16_t crc = block_crc(&_frame[YMODEM_BLOCK_HEADER], block_size, _stats);
+    _frame[YMODEM_BLOCK_HEADER + block_size] = (crc >> 8) & 0xFF;
+    _frame[YMODEM_BLOCK_HEADER + block_size + 1] = crc & 0xFF;
+    _frame_length = block_size + YMODEM_BLOCK_OVERHEAD;
+    _state = _streaming ? STREAM : DATA_ACK;
+  }
+  _retry = 0;
+  send_frame();
+  _deadline = now_ns + YMODEM_TIMEOUT * NS_PER_MS;
+}
+
+// Streaming queues the next block as soon as the previous one leaves, flow control paces the line.
+// The deadline runs from the last output that left, a line held back for longer is given up.
+void YMODEMSender::refill(uint64_t now_ns) {
+  if(_state == STREAM) _deadline = now_ns + YMODEM_TIMEOUT * NS_PER_MS;
+  while((_state == STREAM) && (_status == YMODEM_RUNNING) && output_room(sizeof(_frame))) {
+    _stats.payload(_frame_payload);
+    _offset += _frame_payload;
+    _blocknumber++;
+    _source.acknowledged(_offset);
+    send_data(now_ns);
+  }
+}
+
+// No usable response to the last frame, send it again
+void YMODEMSender::retry(uint64_t now_ns) {
+  if(++_retry >= YMODEM_MAX_RETRY) {
+    // The receiver may have missed the ACK of the final block, the batch is done anyway
+    if(_state == FINAL_ACK) done();
+    else fail("Max retries");
+    return;
+  }
+  _stats.retry();
+  YMODEM_PROBE1(retry, _retry);
+  send_frame();
+  _deadline = now_ns + YMODEM_TIMEOUT * NS_PER_MS;
+}
+
+void YMODEMSender::response(uint8_t c, uint64_t now_ns) {
+  uint64_t rtt;
+
+  switch(c) {
+    case YMODEM_ACK:
+      rtt = now_ns - _sent_ns;
+      YMODEM_PROBE1(ack, rtt);
+      _stats.ack(rtt);
+      break;
+    case YMODEM_NAK:
+      YMODEM_PROBE0(nak);
+      _stats.nak();
+      break;
+    case YMODEM_CAN:
+      YMODEM_PROBE0(cancel);
+      _stats.cancel();
+      break;
+  }
+
+  if(c != YMODEM_ACK) {
+    if((c == YMODEM_CAN) && ((_state == HEADER_ACK) || (_state == DATA_ACK) || (_state == STREAM))) fail("Receiver aborts");
+    else if(_state != STREAM) retry(now_ns);
+    return;
+  }
+
+  switch(_state) {
+    case HEADER_ACK:
+      _state = WAIT_DATA;
+      _retry = 0;
+      _deadline = now_ns + YMODEM_TIMEOUT * NS_PER_MS;
+      break;
+    case DATA_ACK:
+      _stats.payload(_frame_payload);
+      _offset += _frame_payload;
+      _blocknumber++;
+      _source.acknowledged(_offset);
+      send_data(now_ns);
+      break;
+    case EOT_ACK:
+      _stats.endFile(true);
+      _source.complete();
+      _state = WAIT_HEADER;
+      _retry = 0;
+      _deadline = now_ns + YMODEM_TIMEOUT * NS_PER_MS;
+      break;
+    case FINAL_ACK:
+      done();
+      break;
+    default:
+      break;
+  }
+}
+
+void YMODEMSender::receive(const uint8_t *data, size_t length, uint64_t now_ns) {
+  activity(now_ns);
+  _stats.rx(length);
+
+  for(size_t n = 0; (n < length) && (_status == YMODEM_RUNNING); n++) {
+    uint8_t c = data[n];
+
+    switch(_state) {
+      case FLUSH:
+        break;
+      case WAIT_RECEIVER:
+        if((c == YMODEM_DEFCRC16) || (c == YMODEM_STREAM)) {
+          _streaming = (c == YMODEM_STREAM);
+          send_header(now_ns);
+        }
+        break;
+      case WAIT_HEADER:
+      case WAIT_DATA:
+        if((c == YMODEM_DEFCRC16) || (c == YMODEM_STREAM)) {
+          if(_state == WAIT_HEADER) send_header(now_ns);
+          else {
+            _offset = 0;
+            _blocknumber = 1;
+            send_data(now_ns);
+          }
+        }
+        else if(++_retry >= YMODEM_MAX_RETRY) fail("Max retries");
+        break;
+      default:
+        response(c, now_ns);
+        break;
+    }
+  }
+}
+
+void YMODEMSender::poll(uint64_t now_ns) {
+  if((_status != YMODEM_RUNNING) || (now_ns < _deadline)) return;
+
+  switch(_state) {
+    case FLUSH:
+      _state = WAIT_RECEIVER;
+      _deadline = YMODEM_NO_DEADLINE;
+      break;
+    case WAIT_RECEIVER:
+      break;
+    case WAIT_HEADER:
+    case WAIT_DATA:
+      YMODEM_PROBE1(timeout, YMODEM_TIMEOUT);
+      if(++_retry >= YMODEM_MAX_RETRY) fail("Max retries");
+      else _deadline = now_ns + YMODEM_TIMEOUT * NS_PER_MS;
+      break;
+    case STREAM:
+      YMODEM_PROBE1(timeout, YMODEM_TIMEOUT);
+      _stats.timeout();
+      fail("Transmit timeout");
+      break;
+    default:
+      YMODEM_PROBE1(timeout, YMODEM_TIMEOUT);
+      _stats.timeout();
+      retry(now_ns);
+      break;
+  }
+}
+
+//---------------------------------------------------------------
+// Receiver
+//---------------------------------------------------------------
+YMODEMReceiver::YMODEMReceiver(YMODEMSink &sink, YMODEMStats *stats, int baudrate, bool streaming)
+    : YMODEMEngine(stats),
+      _sink(sink),
+      _state(FLUSH),
+      _streaming(streaming),
+      _char_timeout_ns(YMODEM_TIMEOUT * NS_PER_MS),
+      _receiving_data(false),
+      _started(false),
+      _resynced(false),
+      _errors(0),
+      _timeouts(0),
+      _cancels(0),
+      _early_eots(0),
+      _blocknumber(0),
+      _filesize(0),
+      _offset(0),
+      _frame(NULL),
+      _frame_length(0),
+      _rx_length(0)
+{
+  // 10 bits per character on the line
+  if(baudrate > 0) {
+    _char_timeout_ns = YMODEM_CHAR_TIMEOUT_CHARS * 10ULL * 1000000000ULL / baudrate;
+    if(_char_timeout_ns < YMODEM_CHAR_TIMEOUT_MIN * NS_PER_MS) _char_timeout_ns = YMODEM_CHAR_TIMEOUT_MIN * NS_PER_MS;
+  }
+}
+
+void YMODEMReceiver::start(uint64_t now_ns) {
+  _state = FLUSH;
+  _deadline = now_ns + YMODEM_FLUSHTIME * NS_PER_MS;
+  _last_ns = now_ns;
+}
+
+void YMODEMReceiver::send_ack(void) {
+  YMODEM_PROBE0(ack_send);
+  queue(YMODEM_ACK);
+}
+
+void YMODEMReceiver::send_nak(void) {
+  // Nothing is sent again in YMODEM-g
+  if(_streaming) {
+    fail_session("Error in streamed block");
+    return;
+  }
+  YMODEM_PROBE0(nak_send);
+  queue(YMODEM_NAK);
+  _stats.nak();
+}
+
+void YMODEMReceiver::send_reqcrc(void) {
+  queue(_streaming ? YMODEM_STREAM : YMODEM_DEFCRC16);
+}
+
+// Ends the session from this side; the remote is cancelled and unfinished files are dropped
+void YMODEMReceiver::fail_session(const char *message) {
+  if(_status != YMODEM_RUNNING) return;
+
+  fail("%s", message);
+  abort();
+  _sink.finish(false);
+}
+
+void YMODEMReceiver::handle_header(void) {
+  char filename[YMODEM_MAX_NAME_LENGTH + 1];
+  char file_length_data[YMODEM_FILESIZEDATA_LENGTH + 1];
+  const uint8_t *p = &_frame[YMODEM_BLOCK_HEADER];
+  const uint8_t *end = &_frame[_frame_length - YMODEM_BLOCK_TRAILER];
+  size_t i;
+
+  // parse header filename
+  for(i = 0; (p < end) && (*p != 0) && (i < YMODEM_MAX_NAME_LENGTH); i++) filename[i] = *p++;
+  filename[i] = 0;
+
+  // parse header filesize
+  while((p < end) && (*p != 0)) p++;
+  if(p < end) p++;
+  for(i = 0; (p < end) && (*p != ' ') && (*p != 0) && (i < YMODEM_FILESIZEDATA_LENGTH);) file_length_data[i++] = *p++;
+  file_length_data[i] = 0;
+  uint64_t filesize = (i > 0) ? strtoull(file_length_data, NULL, 10) : 0;
+
+  if(!ymodem_sanitize_filename(filename)) {
+    char message[YMODEM_ERROR_LENGTH];
+    snprintf(message, sizeof(message), "Invalid filename \'%s\'", filename);
+    fail_session(message);
+    return;
+  }
+  if(!_sink.open(filename, filesize)) {
+    fail_session(_sink.error() ? _sink.error() : "Error allocating memory");
+    return;
+  }
+  _stats.startFile(filename, filesize);
+  send_reqcrc();
+  _receiving_data = true;
+  _filesize = filesize;
+  _offset = 0;
+}
+
+void YMODEMReceiver::handle_data(void) {
+  size_t length = _frame_length - YMODEM_BLOCK_OVERHEAD;
+  size_t write_len;
+
+  _offset += length;  // total bytes received
+  if(_offset > _filesize) {
+    write_len = length - (_offset - _filesize);
+    _offset = _filesize;
+  }
+  else write_len = length;
+
+  if(!_sink.write(&_frame[YMODEM_BLOCK_HEADER], write_len)) {
+    fail_session(_sink.error() ? _sink.error() : "Error writing data");
+    return;
+  }
+  _stats.payload(write_len);
+  _stats.block();
+}
+
+void YMODEMReceiver::handle_frame(bool timed_out, bool crc_verified, bool end_of_batch) {
+  uint8_t blocktype = _frame[0];
+  uint8_t blocknumber;
+
+  _timeouts = 0;
+  _resynced = false;
+  if(blocktype != YMODEM_CAN) _cancels = 0;
+  if(blocktype != YMODEM_EOT) _early_eots = 0;
+
+  switch(blocktype) {
+    case YMODEM_SOH:
+    case YMODEM_STX:
+      // Check for 'empty' block 0 block, might be early timed out
+      if(end_of_batch) {
+        // All files need to be on disk before the final ACK
+        if(_sink.finish(true)) {
+          send_ack();
+          done();
+        }
+        else {
+          fail("%s", _sink.error() ? _sink.error() : "Error writing files");
+          abort();
+        }
+        return;
+      }
+      // Check for corrupted, smaller than required blocks; ask for it again right away
+      if(timed_out) {
+        _stats.error();
+        _errors++;
+        send_nak();
+        break;
+      }
+      blocknumber = _frame[YMODEM_BLOCK_SEQ_INDEX];
+      if(!crc_verified || (_frame[YMODEM_BLOCK_SEQ_COMP_INDEX] != (255 - blocknumber))) {
+        send_nak();
+        break;
+      }
+      if(blocknumber == _blocknumber) {
+        if(!_streaming) send_ack();
+        if((!_receiving_data) && (blocknumber == 0)) handle_header();
+        else handle_data();
+        _blocknumber++;
+      }
+      else if(!_streaming && _receiving_data && (blocknumber == (uint8_t)(_blocknumber - 1))) {
+        // Our ACK got lost and the sender repeats the previous block; it was stored already
+        YMODEM_PROBE1(duplicate, blocknumber);
+        send_ack();
+        if((blocknumber == 0) && (_offset == 0)) send_reqcrc(); // repeated header, the sender waits for 'C' again
+      }
+      else {
+        // Out of sequence, the sender has to go back to the expected block
+        _stats.error();
+        _errors++;
+        send_nak();
+      }
+      break;
+    case YMODEM_EOT:
+      if(!_receiving_data) {
+        // Repeated EOT after a lost ACK, the file is closed already
+        YMODEM_PROBE1(duplicate, 0);
+        send_ack();
+        send_reqcrc();
+        break;
+      }
+      if(_offset != _filesize) {
+        // Data is missing; a stray EOT is asked for again, a repeated one really ends the file short
+        _stats.error();
+        _errors++;
+        if(++_early_eots > 1) fail_session("File shorter than announced");
+        else send_nak();
+        break;
+      }
+      if(!_sink.close()) {
+        fail_session(_sink.error() ? _sink.error() : "Error writing data");
+        return;
+      }
+      send_ack();
+      _stats.endFile(true);
+      _receiving_data = false;
+      _blocknumber = 0;
+      _offset = 0;
+      send_reqcrc();
+      break;
+    case YMODEM_CAN:
+      YMODEM_PROBE0(cancel);
+      _stats.cancel();
+      if(++_cancels > 1) fail_session("Remote abort");
+      break;
+    default:
+      _stats.error();
+      _errors++;
+  }
+  if(_errors > YMODEM_MAX_ERRORS) fail_session("Max errors");
+}
+
+// Offset of the first byte that may start a frame, or length if there is none
+static size_t find_frame_start(const uint8_t *data, size_t length) {
+  const uint8_t *soh = (const uint8_t *)memchr(data, YMODEM_SOH, length);
+  const uint8_t *stx = (const uint8_t *)memchr(data, YMODEM_STX, soh ? (size_t)(soh - data) : length);
+
+  if(stx) return stx - data;
+  if(soh) return soh - data;
+  return length;
+}
+
+// Drops the first bytes of the receive buffer
+void YMODEMReceiver::consume(size_t length) {
+  memmove(_rx, _rx + length, _rx_length - length);
+  _rx_length -= length;
+}
+
+// Skips line noise up to the next candidate frame header, counted as a single error.
+// If no block follows within the character timeout, poll() asks for it again.
+void YMODEMReceiver::resync(size_t from) {
+  size_t skip = from + find_frame_start(_rx + from, _rx_length - from);
+
+  YMODEM_PROBE1(resync, skip);
+  _state = IDLE;
+  consume(skip);
+  _stats.error();
+  _errors++;
+  _resynced = true;
+}
+
+// Hands a received frame of _frame_length bytes at the start of the buffer to handle_frame()
+void YMODEMReceiver::frame_complete(bool timed_out) {
+  bool crc_verified = false;
+  bool end_of_batch;
+
+  _state = IDLE;
+  _started = true;
+  _frame = _rx;
+  YMODEM_PROBE3(frame_end, _frame[0], _frame_length, timed_out);
+  if(!timed_out) {
+    crc_verified = (block_crc(&_frame[YMODEM_BLOCK_HEADER], _frame_length - YMODEM_BLOCK_HEADER, _stats) == 0);
+    YMODEM_PROBE2(crc, _frame[YMODEM_BLOCK_SEQ_INDEX], crc_verified);
+  }
+  end_of_batch = !_receiving_data && (_frame_length > YMODEM_BLOCK_HEADER) && (_frame[YMODEM_BLOCK_SEQ_INDEX] == 0) && (_frame[YMODEM_BLOCK_HEADER] == 0);
+  handle_frame(timed_out, crc_verified, end_of_batch);
+  consume(_frame_length);
+}
+
+// Decodes all complete frames in the receive buffer. A header is accepted as soon as its
+// sequence number and complement agree, anything else is skipped up to the next SOH/STX,
+// so a frame following line noise is found without waiting for a timeout.
+void YMODEMReceiver::decode(void) {
+  while((_rx_length > 0) && (_status == YMODEM_RUNNING)) {
+    uint8_t c = _rx[0];
+
+    if((c == YMODEM_SOH) || (c == YMODEM_STX)) {
+      if((_rx_length > YMODEM_BLOCK_SEQ_COMP_INDEX) && (_rx[YMODEM_BLOCK_SEQ_COMP_INDEX] != 255 - _rx[YMODEM_BLOCK_SEQ_INDEX])) {
+        resync(1);
+        continue;
+      }
+      if(_state != FRAME) {
+        YMODEM_PROBE1(frame_start, c);
+        _state = FRAME;
+      }
+      _frame_length = ((c == YMODEM_SOH) ? YMODEM_BLOCKSIZE_128 : YMODEM_BLOCKSIZE_1K) + YMODEM_BLOCK_OVERHEAD;
+      if(_rx_length < _frame_length) return;  // rest of the frame still on its way
+      frame_complete(false);
+      continue;
+    }
+
+    // Single byte messages. Whatever follows is decoded on its own, a stray EOT must not take a block with it.
+    if((c == YMODEM_CAN) || (c == YMODEM_EOT)) {
+      YMODEM_PROBE1(frame_start, c);
+      _frame_length = 1;
+      _frame = _rx;
+      handle_frame(false, false, false);
+      consume(1);
+      continue;
+    }
+    resync(0);
+  }
+}
+
+void YMODEMReceiver::receive(const uint8_t *data, size_t length, uint64_t now_ns) {
+  activity(now_ns);
+  _stats.rx(length);
+  if(_state == FLUSH) return;
+
+  while((length > 0) && (_status == YMODEM_RUNNING)) {
+    // decode() leaves at most one incomplete frame, so there is always room for another
+    size_t n = (length < sizeof(_rx) - _rx_length) ? length : sizeof(_rx) - _rx_length;
+
+    memcpy(_rx + _rx_length, data, n);
+    _rx_length += n;
+    data += n;
+    length -= n;
+    decode();
+  }
+  // The rest of a started block follows within a few character times, as does a block behind noise;
+  // a new block may take longer
+  if(_status == YMODEM_RUNNING) _deadline = now_ns + (((_state == FRAME) || _resynced) ? _char_timeout_ns : YMODEM_TIMEOUT * NS_PER_MS);
+}
+
+void YMODEMReceiver::poll(uint64_t now_ns) {
+  if((_status != YMODEM_RUNNING) || (now_ns < _deadline)) return;
+
+  if(_state == FLUSH) {
+    _state = IDLE;
+    send_reqcrc();
+  }
+  else if(_state == FRAME) {
+    // Incomplete block, a truncated final header still ends the batch
+    YMODEM_PROBE1(timeout, _char_timeout_ns / NS_PER_MS);
+    _frame_length = _rx_length;
+    frame_complete(true);
+  }
+  else if(_resynced) {
+    // Only noise arrived, the block it replaced is asked for again
+    YMODEM_PROBE1(timeout, _char_timeout_ns / NS_PER_MS);
+    _resynced = false;
+    if(_started) send_nak();
+    else send_reqcrc();
+  }
+  else {
+    YMODEM_PROBE1(timeout, YMODEM_TIMEOUT);
+    _stats.timeout();
+    if(_blocknumber && (++_timeouts > YMODEM_MAX_RETRY)) fail_session("Timeout");
+    else send_reqcrc();
+  }
+  if(_status == YMODEM_RUNNING) _deadline = now_ns + YMODEM_TIMEOUT * NS_PER_MS;
+}
+
+// Received names may carry a relative path. Strip leading slashes and refuse to leave the target directory.
+bool ymodem_sanitize_filename(char *filename) {
+  char *p = filename;
+
+  while(*p == '/') p++;
+  memmove(filename, p, strlen(p) + 1);
+  if(filename[0] == 0) return false;
+
+  for(p = filename; p; p = strchr(p, '/')) {
+    if(*p == '/') p++;
+    if((strncmp(p, "..", 2) == 0) && ((p[2] == '/') || (p[2] == 0))) return false;
+  }
+  return true;
+}
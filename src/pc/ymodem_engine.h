@@ -0,0 +1,221 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// YMODEM protocol constants
+#define YMODEM_MAX_NAME_LENGTH         100
+#define YMODEM_BLOCK_SEQ_INDEX         1
+#define YMODEM_BLOCK_SEQ_COMP_INDEX    2
+#define YMODEM_BLOCK_HEADER            3
+#define YMODEM_BLOCK_TRAILER           2
+#define YMODEM_BLOCK_OVERHEAD          (YMODEM_BLOCK_HEADER + YMODEM_BLOCK_TRAILER)
+#define YMODEM_BLOCKSIZE_128           128
+#define YMODEM_BLOCKSIZE_1K            1024
+#define YMODEM_FILESIZEDATA_LENGTH     16
+#define YMODEM_SOH                     0x01  // 128 byte data block
+#define YMODEM_STX                     0x02  // 1024 byte data block
+#define YMODEM_EOT                     0x04
+#define YMODEM_ACK                     0x06
+#define YMODEM_NAK                     0x15
+#define YMODEM_CAN                     0x18
+#define YMODEM_DEFCRC16                0x43
+#define YMODEM_STREAM                  0x47  // 'G', YMODEM-g: blocks are not ACKed, the link must not lose data
+#define YMODEM_TIMEOUT                 1200  // ms, block and handshake timeout
+#define YMODEM_CHAR_TIMEOUT_CHARS      32    // silence within a block, in character times
+#define YMODEM_CHAR_TIMEOUT_MIN        20    // ms, covers USB adapter latency and scheduling
+#define YMODEM_FLUSHTIME               200
+#define YMODEM_MAX_ERRORS              32
+#define YMODEM_MAX_RETRY               3
+
+#define YMODEM_NO_DEADLINE             UINT64_MAX
+#define YMODEM_ERROR_LENGTH            160
+
+typedef enum {
+  YMODEM_RUNNING,
+  YMODEM_DONE,
+  YMODEM_FAILED
+} ymodem_status_t;
+
+// Counters of a session, optional. The engine reports every event, a caller that keeps
+// statistics overrides what it needs; by default nothing is counted.
+class YMODEMStats {
+  public:
+    virtual ~YMODEMStats() {}
+
+    virtual void startFile(const char *name, uint64_t size) { (void)name; (void)size; }
+    virtual void endFile(bool complete) { (void)complete; }
+    virtual void payload(size_t bytes) { (void)bytes; }
+    virtual void tx(size_t bytes) { (void)bytes; }
+    virtual void rx(size_t bytes) { (void)bytes; }
+    virtual void block(void) {}
+    virtual void nak(void) {}
+    virtual void timeout(void) {}
+    virtual void retry(void) {}
+    virtual void error(void) {}
+    virtual void cancel(void) {}
+    virtual void startCrc(void) {}                            // around each block CRC, for its cost
+    virtual void endCrc(void) {}
+    virtual void ack(uint64_t rtt_ns) { (void)rtt_ns; }
+    virtual void idle(uint64_t ns) { (void)ns; }
+};
+
+// Files to send, provided by the caller
+class YMODEMSource {
+  public:
+    virtual ~YMODEMSource() {}
+
+    virtual bool next(const char **name, uint64_t *size) = 0;  // next file of the batch, false at the end
+    virtual bool read(uint64_t offset, uint8_t *buffer, size_t length) = 0;
+    virtual void acknowledged(uint64_t offset) { (void)offset; }  // receiver has all data up to offset
+    virtual void complete(void) {}                                 // receiver has the entire file
+    virtual const char *error(void) { return NULL; }               // set if next() or read() failed
+};
+
+// Received files, stored by the caller
+class YMODEMSink {
+  public:
+    virtual ~YMODEMSink() {}
+
+    virtual bool open(const char *name, uint64_t size) = 0;
+    virtual bool write(const uint8_t *data, size_t length) = 0;
+    virtual bool close(void) = 0;                 // end of file
+    virtual bool finish(bool complete) = 0;       // end of batch; all files are kept only if complete
+    virtual const char *error(void) { return NULL; }
+};
+
+// Protocol state machine without any I/O of its own. The caller runs the transfer:
+//   - start() once, then
+//   - send the bytes from output() and report them with sent(),
+//   - feed received bytes with receive() and call poll() when deadline() has passed,
+// until status() is no longer YMODEM_RUNNING. All times are monotonic nanoseconds, given by
+// the caller; the engine has no clock of its own.
+// Each instance has its own buffers, so any number of sessions can run from one thread.
+// A receiver started with 'streaming' asks for YMODEM-g, senders follow whichever the receiver asks for.
+class YMODEMEngine {
+  public:
+    YMODEMEngine(YMODEMStats *stats);
+    virtual ~YMODEMEngine() {}
+
+    virtual void start(uint64_t now_ns) = 0;
+    virtual void receive(const uint8_t *data, size_t length, uint64_t now_ns) = 0;
+    virtual void poll(uint64_t now_ns) = 0;
+
+    size_t output(const uint8_t **data);
+    void sent(size_t length, uint64_t now_ns);
+    uint64_t deadline(void) { return _deadline; }
+    ymodem_status_t status(void) { return _status; }
+    const char *error(void) { return _error; }
+
+  protected:
+    virtual void refill(uint64_t now_ns) { (void)now_ns; }  // output has been sent, room for more
+    bool output_room(size_t length);
+    void queue(const uint8_t *data, size_t length);
+    void queue(uint8_t c);
+    void abort(void);  // queues a cancel sequence to the remote
+    void fail(const char *format, ...);
+    void done(void);
+    void activity(uint64_t now_ns);
+
+    YMODEMStats &_stats;
+    uint64_t _deadline;
+    uint64_t _sent_ns;   // time the last output left
+    uint64_t _last_ns;   // time of the last line activity
+    ymodem_status_t _status;
+    char _error[YMODEM_ERROR_LENGTH];
+
+  private:
+    uint8_t _output[2 * (1 + YMODEM_BLOCKSIZE_1K + YMODEM_BLOCK_OVERHEAD)];
+    size_t _output_length;
+    size_t _output_offset;
+};
+
+class YMODEMSender : public YMODEMEngine {
+  public:
+    YMODEMSender(YMODEMSource &source, YMODEMStats *stats = NULL);
+
+    void start(uint64_t now_ns) override;
+    void receive(const uint8_t *data, size_t length, uint64_t now_ns) override;
+    void poll(uint64_t now_ns) override;
+
+  private:
+    typedef enum {
+      FLUSH,            // ignoring stale input
+      WAIT_RECEIVER,    // waiting for the receiver's first 'C', no time limit
+      WAIT_HEADER,      // waiting for 'C' before a header block
+      HEADER_ACK,
+      WAIT_DATA,        // waiting for 'C' before the data blocks
+      DATA_ACK,
+      STREAM,           // data blocks back to back, YMODEM-g
+      EOT_ACK,
+      FINAL_ACK         // empty header block, ends the batch
+    } state_t;
+
+    void refill(uint64_t now_ns) override;
+    void response(uint8_t c, uint64_t now_ns);
+    void retry(uint64_t now_ns);
+    void send_header(uint64_t now_ns);
+    void send_data(uint64_t now_ns);
+    void send_frame(void);
+
+    YMODEMSource &_source;
+    state_t _state;
+    bool _streaming;
+    int _retry;
+    uint64_t _filesize;
+    uint64_t _offset;
+    uint8_t _blocknumber;
+    size_t _frame_length;
+    size_t _frame_payload;
+    uint8_t _frame[1 + YMODEM_BLOCKSIZE_1K + YMODEM_BLOCK_OVERHEAD];
+};
+
+class YMODEMReceiver : public YMODEMEngine {
+  public:
+    YMODEMReceiver(YMODEMSink &sink, YMODEMStats *stats = NULL, int baudrate = 0, bool streaming = false); // baudrate 0: unknown
+
+    void start(uint64_t now_ns) override;
+    void receive(const uint8_t *data, size_t length, uint64_t now_ns) override;
+    void poll(uint64_t now_ns) override;
+
+  private:
+    typedef enum {
+      FLUSH,            // ignoring stale input
+      IDLE,             // waiting for the start of a block
+      FRAME             // header received, waiting for the rest of the block
+    } state_t;
+
+    void decode(void);
+    void resync(size_t from);
+    void consume(size_t length);
+    void frame_complete(bool timed_out);
+    void handle_frame(bool timed_out, bool crc_verified, bool end_of_batch);
+    void handle_header(void);
+    void handle_data(void);
+    void send_ack(void);
+    void send_nak(void);
+    void send_reqcrc(void);
+    void fail_session(const char *message);
+
+    YMODEMSink &_sink;
+    state_t _state;
+    bool _streaming;            // YMODEM-g, any error ends the session
+    uint64_t _char_timeout_ns;  // an incomplete block is given up after this much silence
+    bool _receiving_data;
+    bool _started;              // a block has been received
+    bool _resynced;             // bytes were dropped as noise and no block has followed yet
+    size_t _errors;
+    size_t _timeouts;
+    uint8_t _cancels;
+    uint8_t _early_eots;        // EOTs in a row before all announced data has arrived
+    uint8_t _blocknumber;
+    uint64_t _filesize;
+    uint64_t _offset;
+    const uint8_t *_frame;     // frame being handled, at the start of _rx
+    size_t _frame_length;
+    uint8_t _rx[2 * (1 + YMODEM_BLOCKSIZE_1K + YMODEM_BLOCK_OVERHEAD)];
+    size_t _rx_length;
+};
+
+// Received names may carry a relative path. Strips leading slashes and refuses names that leave the target directory.
+bool ymodem_sanitize_filename(char *filename);